@@ -0,0 +1,77 @@
+#include "CarModel.h"
+
+ModelParams defaultModelParams(){
+    ModelParams params;
+    params.cruise_speed = CRUISE_SPEED;
+    params.max_speed = MAX_SPEED;
+    params.profile = &vehicleProfile(VEHICLE_PROFILE);
+    return params;
+}
+
+CruisePid makeCruisePid(uint32_t period_ms){
+    return CruisePid(sim_t(CRUISE_KP), sim_t(CRUISE_KI), sim_t(CRUISE_KD), sim_t((int)period_ms) / 1000,
+                     sim_t(CRUISE_D_TAU), sim_t(-1), sim_t(1));
+}
+
+CruiseCommand cruiseControlStep(CruisePid &pid, const ModelParams &params, const VehicleState &state, const DriverInputs &inputs){
+    CruiseCommand command;
+    command.engaged = inputs.cruise_switch && inputs.ignition;  //In cruise control mode only when ignition is on
+    command.accel = 0;
+    command.brakes = 0;
+
+    if(!command.engaged){
+        pid.reset();                                            //Start from scratch on the next engage
+        return command;
+    }
+    
+    const sim_t output = pid.update(params.cruise_speed, state.speed, holdingPedals(*params.profile, params.cruise_speed));
+    if(output > 0){                                             //Positive output drives the accelerator, negative the brakes
+        command.accel = output;
+    }
+    else{
+        command.brakes = -output;
+    }
+    return command;
+}
+
+//Fixed sub-steps then the remainder, distance is summed over the step so small increments are not lost in odometry
+template<typename Dynamics>
+static sim_t integrateStep(const Dynamics &dynamics, sim_t &speed, sim_t pedals, uint32_t dt_us, sim_t max_speed){
+    const uint32_t substep_us = 1000000 / SIM_SUBSTEP_HZ;
+    const sim_t h = secondsFromUs(substep_us);
+    sim_t distance(0);
+    while(dt_us >= substep_us){
+        integrate(dynamics, speed, distance, pedals, h, max_speed);
+        dt_us -= substep_us;
+    }
+    if(dt_us > 0){
+        integrate(dynamics, speed, distance, pedals, secondsFromUs(dt_us), max_speed);
+    }
+    return distance;
+}
+
+void simulateStep(VehicleState &state, const ModelParams &params, const DriverInputs &inputs, const CruiseCommand &command, uint32_t dt_us){
+    state.ignition = inputs.ignition;
+    state.cruise_mode = command.engaged;
+    if(command.engaged){                                        //Cruise control drives the pedals
+        state.accel = command.accel;
+        state.brakes = command.brakes;
+    }
+    else{                                                       //Driver drives the pedals
+        state.accel = inputs.accel;
+        state.brakes = inputs.brakes;
+    }
+    
+    if(!state.ignition) state.accel = 0;                        //Accelator disabled if ignition is off
+    const sim_t pedals = netPedals(state.accel, state.brakes, state.ignition);
+    
+    const VehicleProfile &profile = *params.profile;
+    if(profile.drag == NULL){                                   //Closed form for the linear profile
+        state.odometry += integrateStep(LinearDynamics(), state.speed, pedals, dt_us, params.max_speed);
+    }
+    else{                                                       //Table lookups, same cost at every speed
+        CurveDynamics dynamics = {profile};
+        state.odometry += integrateStep(dynamics, state.speed, pedals, dt_us, params.max_speed);
+    }
+    state.step++;
+}
@@ -0,0 +1,170 @@
+#ifndef CAR_MODEL_H
+#define CAR_MODEL_H
+
+#include "VehicleState.h"
+#include "PidController.h"
+#include "VehicleProfile.h"
+#include <stdint.h>
+
+/*
+################################################################################
+Vehicle model and cruise controller
+Pure functions with no hardware access, so they build and run the same on
+the target and in the host benchmark (see host/). The firmware decodes the
+switches into DriverInputs and drives the LEDs around these calls.
+################################################################################
+*/
+
+//Definitions for simulation variables
+#define MIN_SPEED 0
+#define MAX_SPEED 300
+#define LEGAL_SPEED 142                 //88 mph in km/h , km/h used instead of m/s for more realism for a car's display
+#define CRUISE_SPEED 80                 //50 mph in km/h
+#define FRICTION 0.001
+
+//Definitions for the integrator, rates are per second so the dynamics do not depend on the step size
+#define MODEL_TUNING_HZ 25              //Step rate FRICTION and the pedal effect were originally tuned at
+#define PEDAL_RATE (1.0 * MODEL_TUNING_HZ)      //km/h per second at full accelerator or brakes
+#define DRAG_RATE (FRICTION * MODEL_TUNING_HZ)  //Fraction of speed lost per second to drag
+#define UNASSISTED_BRAKING 0.5          //Brake effect with the ignition off, no assisted braking
+#ifndef SIM_SUBSTEP_HZ
+#define SIM_SUBSTEP_HZ 1024             //Internal step rate, a power of two makes the sub-step a whole number of Q16.16 units
+#endif
+#ifndef SIM_INTEGRATOR_RK4
+#define SIM_INTEGRATOR_RK4 0            //Set to 1 to use 4th order Runge-Kutta instead of semi-implicit Euler
+#endif
+
+//Definitions for the cruise controller, output is accelerator (positive) or brakes (negative)
+#define CRUISE_KP 0.1                   //Pedal per km/h of error
+#define CRUISE_KI 0.1                   //Pedal per km/h of error per second
+#define CRUISE_KD 0.01                  //Pedal per km/h per second of deceleration
+#define CRUISE_D_TAU 0.2                //Derivative filter time constant in seconds
+#define CRUISE_FEED_FORWARD (DRAG_RATE / PEDAL_RATE)    //Pedal per km/h needed to hold a speed against drag
+
+typedef PidController<sim_t> CruisePid;
+
+//Settings that can be changed at runtime, the macros above are the defaults
+struct ModelParams {
+    sim_t cruise_speed;                 //Cruise control set speed
+    sim_t max_speed;
+    const VehicleProfile *profile;      //Drag, engine and brake curves
+};
+
+ModelParams defaultModelParams();
+
+//Driver controls decoded from the switches
+struct DriverInputs {
+    sim_t accel;                        //Accelerator pedal
+    sim_t brakes;                       //Brake pedal
+    bool ignition;
+    bool cruise_switch;
+};
+
+/*
+Creates the cruise PID with the CRUISE_* gains precomputed for a controller
+running every period_ms, with its output limited to full brakes..full
+accelerator.
+*/
+CruisePid makeCruisePid(uint32_t period_ms);
+
+/*
+PID cruise controller holding params.cruise_speed. The pedal needed to hold the
+set speed against the profile's drag is fed forward so the integral only has to correct for the remaining error. The
+output is split into accelerator and brakes demands. The demand is only
+engaged when the cruise switch and the ignition are both on, and the PID is
+reset whenever it is not so it starts cleanly on the next engage.
+*/
+CruiseCommand cruiseControlStep(CruisePid &pid, const ModelParams &params, const VehicleState &state, const DriverInputs &inputs);
+
+/*
+Advances the car by dt_us microseconds of simulated time. Accelerator and
+brakes come from the cruise demand when it is engaged, otherwise from the
+pedals, and are held for the whole step. The step is split into fixed
+1/SIM_SUBSTEP_HZ sub-steps plus a shorter final one, so the result does not
+depend on how often this is called. Speed is kept between MIN_SPEED and
+params.max_speed and odometry (speed * seconds) is integrated alongside it.
+The forces come from params.profile.
+*/
+void simulateStep(VehicleState &state, const ModelParams &params, const DriverInputs &inputs, const CruiseCommand &command, uint32_t dt_us);
+
+/*
+################################################################################
+Model terms shared by simulateStep() and the fleet model (FleetModel.h), inline
+so the fleet loops over many cars can be vectorised.
+################################################################################
+*/
+
+//Converts a duration to seconds in the model's number type
+inline sim_t secondsFromUs(uint32_t us){
+#if SIM_FIXED_POINT
+    return Fixed::fromRaw((int32_t)(((int64_t)us * Fixed::ONE + 500000) / 1000000));
+#else
+    return us * 1e-6f;
+#endif
+}
+
+//Net pedal force, accelerator disabled and reduced braking due to lack of assisted braking with the ignition off
+inline sim_t netPedals(sim_t accel, sim_t brakes, bool ignition){
+    return ignition ? accel - brakes : -sim_t(UNASSISTED_BRAKING) * brakes;
+}
+
+//Speed keeps within MIN_SPEED and max_speed after every sub-step
+inline sim_t limitSpeed(sim_t speed, sim_t max_speed){
+    return speed < MIN_SPEED ? sim_t(MIN_SPEED) : speed > max_speed ? max_speed : speed;
+}
+
+//Rate of change of speed in km/h per second, for a net pedal force
+inline sim_t acceleration(sim_t speed, sim_t pedals){
+    return pedals * sim_t(PEDAL_RATE) - sim_t(DRAG_RATE) * speed;
+}
+
+//Rate of change of speed for a profile with curves, pedals as for acceleration()
+inline sim_t acceleration(const VehicleProfile &profile, sim_t speed, sim_t pedals){
+    const sim_t pedal_rate = pedals > 0 ? profile.engine->at(speed) : profile.brake->at(speed);
+    return pedals * pedal_rate - profile.drag->at(speed);
+}
+
+//Pedal needed to hold a speed against drag
+inline sim_t holdingPedals(const VehicleProfile &profile, sim_t speed){
+    if(profile.drag == NULL) return sim_t(CRUISE_FEED_FORWARD) * speed;
+    return profile.drag->at(speed) / profile.engine->at(speed);
+}
+
+//Acceleration of the linear profile, closed form
+struct LinearDynamics {
+    sim_t operator()(sim_t speed, sim_t pedals) const { return acceleration(speed, pedals); }
+};
+
+//Acceleration of a profile with curves, table lookups
+struct CurveDynamics {
+    const VehicleProfile &profile;
+    sim_t operator()(sim_t speed, sim_t pedals) const { return acceleration(profile, speed, pedals); }
+};
+
+//Advances speed by h seconds with constant pedals, and adds the distance covered to distance
+template<typename Dynamics>
+inline void integrate(const Dynamics &dynamics, sim_t &speed, sim_t &distance, sim_t pedals, sim_t h, sim_t max_speed){
+#if SIM_INTEGRATOR_RK4
+    const sim_t v = speed;
+    const sim_t half = h / 2;
+    const sim_t k1 = dynamics(v, pedals);
+    const sim_t v2 = v + half * k1;
+    const sim_t k2 = dynamics(v2, pedals);
+    const sim_t v3 = v + half * k2;
+    const sim_t k3 = dynamics(v3, pedals);
+    const sim_t v4 = v + h * k3;
+    const sim_t k4 = dynamics(v4, pedals);
+    speed = limitSpeed(v + h * (k1 + 2 * k2 + 2 * k3 + k4) / 6, max_speed);  //Divide last, h / 6 is too small for fixed point
+    distance += h * (v + 2 * v2 + 2 * v3 + v4) / 6;                 //Speed is the derivative of odometry
+#else
+    speed = limitSpeed(speed + h * dynamics(speed, pedals), max_speed);
+    distance += speed * h;                                          //Semi-implicit, uses the updated speed
+#endif
+}
+
+//Linear profile, as used by the fleet model
+inline void integrate(sim_t &speed, sim_t &distance, sim_t pedals, sim_t h, sim_t max_speed){
+    integrate(LinearDynamics(), speed, distance, pedals, h, max_speed);
+}
+
+#endif
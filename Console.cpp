@@ -0,0 +1,107 @@
+#include "Console.h"
+#include "FixedFormat.h"
+
+Console::Console(PinName tx, PinName rx, int baud, const ThreadConfig &config)
+    : _serial(tx, rx, baud), _config(config), _thread(config.priority, config.stack_size, config.stack, config.name), _count(0)
+{
+}
+
+bool Console::add(const char *name, const char *help, ConsoleHandler handler){
+    if(_count >= CONSOLE_MAX_COMMANDS) return false;
+    _commands[_count].name = name;
+    _commands[_count].help = help;
+    _commands[_count].handler = handler;
+    _count++;
+    return true;
+}
+
+void Console::start(){
+    prepareStack(_config);
+    _thread.start(callback(this, &Console::run));
+}
+
+void Console::print(const char *text){
+    _serial.write(text, strlen(text));
+}
+
+void Console::println(const char *text){
+    print(text);
+    print("\r\n");
+}
+
+void Console::printInt(int32_t value){
+    printFixed(value, 0);
+}
+
+void Console::printFixed(int32_t value, int decimals){
+    char buffer[24];
+    const int width = sizeof(buffer) - 1;
+    formatFixed(buffer, width, value, decimals);
+    buffer[width] = 0;
+    const char *text = buffer;
+    while(*text == ' ') text++;                         //Formatter right-aligns, drop the padding
+    print(text);
+}
+
+void Console::run(){
+    char line[CONSOLE_LINE_LENGTH];
+    size_t length = 0;
+    print("> ");
+    while(true){
+        char c;
+        if(_serial.read(&c, 1) != 1) continue;          //Blocks until a character arrives
+        
+        if(c == '\r' || c == '\n'){
+            print("\r\n");
+            line[length] = 0;
+            execute(line);
+            length = 0;
+            print("> ");
+        }
+        else if(c == '\b' || c == 0x7F){                //Backspace
+            if(length > 0){
+                length--;
+                print("\b \b");
+            }
+        }
+        else if(length < sizeof(line) - 1 && c >= ' '){
+            line[length++] = c;
+            _serial.write(&c, 1);                       //Echo
+        }
+    }
+}
+
+void Console::execute(char *line){
+    char *argv[CONSOLE_MAX_ARGS];
+    int argc = 0;
+    char *word = line;
+    while(*word && argc < CONSOLE_MAX_ARGS){            //Split into words in place
+        while(*word == ' ') *word++ = 0;
+        if(!*word) break;
+        argv[argc++] = word;
+        while(*word && *word != ' ') word++;
+    }
+    if(*word) *word = 0;                                //Ignore anything past the last argument
+    if(argc == 0) return;
+
+    if(strcmp(argv[0], "help") == 0){
+        help();
+        return;
+    }
+    for(size_t i = 0; i < _count; i++){
+        if(strcmp(argv[0], _commands[i].name) == 0){
+            _commands[i].handler(*this, argc, argv);
+            return;
+        }
+    }
+    print("unknown command: ");
+    println(argv[0]);
+}
+
+void Console::help(){
+    for(size_t i = 0; i < _count; i++){
+        print(_commands[i].name);
+        print(" - ");
+        println(_commands[i].help);
+    }
+}
@@ -0,0 +1,56 @@
+#ifndef CONSOLE_H
+#define CONSOLE_H
+
+#include "mbed.h"
+#include "ThreadConfig.h"
+
+#define CONSOLE_MAX_COMMANDS 20
+#define CONSOLE_LINE_LENGTH 64
+#define CONSOLE_MAX_ARGS 4              //Command name included
+
+class Console;
+typedef void (*ConsoleHandler)(Console &console, int argc, char **argv);
+
+struct ConsoleCommand {
+    const char *name;
+    const char *help;
+    ConsoleHandler handler;
+};
+
+/*
+################################################################################
+Serial command console
+Reads lines on its own low priority thread, splits them into words and runs
+the command registered under the first word. "help" lists the commands.
+Output goes through the buffered serial driver so it only blocks the console
+thread when the transmit buffer is full. Numbers are printed with integer
+formatting only, see printFixed().
+################################################################################
+*/
+class Console {
+public:
+    Console(PinName tx, PinName rx, int baud, const ThreadConfig &config);
+
+    bool add(const char *name, const char *help, ConsoleHandler handler);  //Register before start()
+    void start();
+
+    void print(const char *text);
+    void println(const char *text = "");
+    void printInt(int32_t value);
+    void printFixed(int32_t value, int decimals);   //Value in 1/10^decimals units, without padding
+
+    const Thread &thread() const { return _thread; }
+
+private:
+    void run();
+    void execute(char *line);
+    void help();
+
+    UARTSerial _serial;
+    const ThreadConfig &_config;
+    Thread _thread;
+    ConsoleCommand _commands[CONSOLE_MAX_COMMANDS];
+    size_t _count;
+};
+
+#endif
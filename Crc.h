@@ -0,0 +1,26 @@
+#ifndef CRC_H
+#define CRC_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+################################################################################
+CRC-32 (IEEE 802.3, as used by zlib) computed a nibble at a time from a
+16 entry table, a compromise between a 1 KB table and bit-by-bit loops.
+Pass the previous result as crc to continue over several buffers, start
+with 0.
+################################################################################
+*/
+uint32_t crc32(const void *data, size_t length, uint32_t crc = 0);
+
+/*
+################################################################################
+CRC-16/CCITT-FALSE (polynomial 0x1021, initial value 0xFFFF), cheap enough
+to run on every telemetry frame. Pass the previous result as crc to continue
+over several buffers.
+################################################################################
+*/
+uint16_t crc16(const void *data, size_t length, uint16_t crc = 0xFFFF);
+
+#endif
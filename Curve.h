@@ -0,0 +1,48 @@
+#ifndef CURVE_H
+#define CURVE_H
+
+#include "VehicleState.h"
+
+/*
+################################################################################
+Lookup table curve
+N points of a function sampled evenly from x_min to x_max, built by
+makeCurve() at compile time so a table declared constexpr costs no start up
+time and lives in flash. at() interpolates linearly between the two nearest
+points and holds the end values outside the range, so every lookup costs the
+same. The points are sim_t, the function itself is only ever run on the
+compiler in double precision.
+################################################################################
+*/
+template<int N>
+struct Curve {
+    sim_t x_min;
+    sim_t points_per_x;                 //Inverse of the spacing, so a lookup multiplies instead of divides
+    sim_t y[N];
+
+    sim_t at(sim_t x) const {
+        const sim_t position = (x - x_min) * points_per_x;
+        if(!(position > 0)) return y[0];
+        const int index = wholePart(position);
+        if(index >= N - 1) return y[N - 1];
+        return y[index] + (position - index) * (y[index + 1] - y[index]);
+    }
+
+private:
+    static int wholePart(float value) { return (int)value; }    //Only used for positive values
+    static int wholePart(Fixed value) { return value.toInt(); }
+};
+
+template<int N>
+constexpr Curve<N> makeCurve(double x_min, double x_max, double (*function)(double)){
+    static_assert(N >= 2, "a curve needs at least two points");
+    Curve<N> curve = {};
+    curve.x_min = sim_t(x_min);
+    curve.points_per_x = sim_t((N - 1) / (x_max - x_min));
+    for(int i = 0; i < N; i++){
+        curve.y[i] = sim_t(function(x_min + (x_max - x_min) * i / (N - 1)));
+    }
+    return curve;
+}
+
+#endif
@@ -0,0 +1,38 @@
+#ifndef CYCLE_COUNTER_H
+#define CYCLE_COUNTER_H
+
+#include "mbed.h"
+
+/*
+################################################################################
+Cycle counter
+Free-running timestamp for measuring short intervals. Uses the DWT cycle
+counter on Cortex-M3 and above, which costs a single register read, and falls
+back to the microsecond ticker on cores without one. Differences are correct
+across wraparound as long as the interval is shorter than one wrap (about 44 s
+at 96 MHz).
+################################################################################
+*/
+namespace CycleCounter {
+
+#if defined(__CORTEX_M) && (__CORTEX_M >= 3)
+inline void init(){
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;         //Enable trace block so DWT runs
+    DWT->CYCCNT = 0;
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+}
+
+inline uint32_t now(){ return DWT->CYCCNT; }
+
+inline uint32_t toUs(uint32_t ticks){ return ticks / (SystemCoreClock / 1000000); }
+#else
+inline void init(){}
+
+inline uint32_t now(){ return us_ticker_read(); }
+
+inline uint32_t toUs(uint32_t ticks){ return ticks; }
+#endif
+
+}
+
+#endif
@@ -0,0 +1,51 @@
+#ifndef DOUBLE_BUFFER_H
+#define DOUBLE_BUFFER_H
+
+#include <atomic>
+#include <stdint.h>
+
+/*
+################################################################################
+Double-buffered publish for a single writer and any number of readers
+The writer fills the slot readers are not using and then flips the sequence
+number, so it never waits. A reader copies the latest complete slot and only
+retries if the writer started reusing that slot during the copy, which can
+only happen when the writer preempted the reader. A reader that preempts the
+writer always finds a complete slot, so it never spins on a lower priority
+writer.
+################################################################################
+*/
+template <typename T>
+class DoubleBuffer {
+public:
+    DoubleBuffer() : _sequence(0) {}
+    explicit DoubleBuffer(const T &initial) : _sequence(0) { _slots[0] = initial; _slots[1] = initial; }
+
+    //Writer side, wait-free
+    void publish(const T &value){
+        const uint32_t sequence = _sequence.load(std::memory_order_relaxed) + 1;
+        _slots[sequence & 1] = value;                               //Slot readers are not using
+        _sequence.store(sequence, std::memory_order_release);       //Make it the latest
+    }
+
+    //Reader side, returns a consistent copy of the latest value
+    T read() const {
+        while(true){
+            const uint32_t sequence = _sequence.load(std::memory_order_acquire);
+            T copy = _slots[sequence & 1];
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if(_sequence.load(std::memory_order_relaxed) == sequence){  //Writer did not move on to our slot
+                return copy;
+            }
+        }
+    }
+
+    //Number of values published since start
+    uint32_t sequence() const { return _sequence.load(std::memory_order_acquire); }
+
+private:
+    T _slots[2];
+    std::atomic<uint32_t> _sequence;
+};
+
+#endif
@@ -0,0 +1,66 @@
+#include "FixedFormat.h"
+
+void formatFixed(char *out, int width, int32_t value, int decimals){
+    if(width <= 0) return;
+    if(decimals < 0) decimals = 0;
+
+    const bool negative = value < 0;
+    uint32_t magnitude = negative ? 0u - (uint32_t)value : (uint32_t)value;
+
+    char digits[10 + 9];                            //Enough for 2^32 plus leading zeros up to 9 decimals
+    int count = 0;
+    do{                                             //Least significant digit first, at least one before the point
+        digits[count++] = '0' + magnitude % 10;
+        magnitude /= 10;
+    } while((magnitude != 0 || count <= decimals) && count < (int)sizeof(digits));
+
+    const int length = count + (decimals > 0) + negative;
+    if(length > width){                             //Did not fit
+        for(int i = 0; i < width; i++) out[i] = '*';
+        return;
+    }
+
+    int position = width;                           //Fill from the right
+    for(int i = 0; i < count; i++){
+        if(decimals > 0 && i == decimals) out[--position] = '.';
+        out[--position] = digits[i];
+    }
+    if(negative) out[--position] = '-';
+    while(position > 0) out[--position] = ' ';      //Pad to the left
+}
+
+bool parseFixed(const char *text, int decimals, int32_t *value){
+    bool negative = false;
+    if(*text == '-' || *text == '+') negative = *text++ == '-';
+
+    int64_t result = 0;
+    int fraction_digits = -1;                       //-1 until the decimal point is seen
+    bool digits = false;
+    bool round_up = false;
+    for(; *text; text++){
+        if(*text == '.' && fraction_digits < 0){
+            fraction_digits = 0;
+            continue;
+        }
+        if(*text < '0' || *text > '9') return false;
+        digits = true;
+        if(fraction_digits >= decimals){            //Beyond the precision kept, only the first one matters for rounding
+            if(fraction_digits == decimals) round_up = *text >= '5';
+            fraction_digits++;
+            continue;
+        }
+        result = result * 10 + (*text - '0');
+        if(fraction_digits >= 0) fraction_digits++;
+        if(result > INT32_MAX) return false;
+    }
+    if(!digits) return false;
+
+    for(int i = fraction_digits < 0 ? 0 : fraction_digits; i < decimals; i++){
+        result *= 10;                               //Scale up missing fractional digits
+        if(result > INT32_MAX) return false;
+    }
+    if(round_up) result++;
+    if(result > INT32_MAX) return false;
+    *value = (int32_t)(negative ? -result : result);
+    return true;
+}
@@ -0,0 +1,29 @@
+#ifndef FIXED_FORMAT_H
+#define FIXED_FORMAT_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+################################################################################
+Fixed-point decimal formatter
+Formats an integer number of 1/10^decimals units (e.g. tenths of a km/h) as a
+right-aligned decimal number exactly width characters wide, like printf's
+"%*.*f" but with integer arithmetic only, so float printf support is not
+linked in. Values that do not fit are shown as a row of '*'.
+No terminator is written.
+################################################################################
+*/
+void formatFixed(char *out, int width, int32_t value, int decimals);
+
+/*
+################################################################################
+Fixed-point decimal parser
+Parses text such as "-12.5" into an integer number of 1/10^decimals units,
+the reverse of formatFixed(). Extra fractional digits are rounded. Returns
+false if the text is not a plain decimal number or does not fit.
+################################################################################
+*/
+bool parseFixed(const char *text, int decimals, int32_t *value);
+
+#endif
@@ -0,0 +1,121 @@
+#ifndef FIXED_POINT_H
+#define FIXED_POINT_H
+
+#include <stdint.h>
+
+/*
+################################################################################
+Q16.16 fixed-point number
+Signed 32-bit value with 16 fractional bits, range about +-32768 with a
+resolution of 1/65536. Integer and floating point values convert implicitly so
+the simulation can be written once for both float and Fixed, conversions of
+constants are constexpr and fold at compile time. Multiply and divide use a
+64-bit intermediate, results outside the range wrap like integers.
+################################################################################
+*/
+class Fixed {
+public:
+    static const int FRACTION_BITS = 16;
+    static const int32_t ONE = 1 << FRACTION_BITS;
+
+    constexpr Fixed() : _raw(0) {}
+    constexpr Fixed(int value) : _raw(value * ONE) {}
+    constexpr Fixed(double value) : _raw((int32_t)(value * ONE + (value < 0 ? -0.5 : 0.5))) {}
+
+    static constexpr Fixed fromRaw(int32_t raw) { return Fixed(raw, RawTag()); }
+
+    constexpr int32_t raw() const { return _raw; }
+    constexpr float toFloat() const { return (float)_raw / ONE; }
+    constexpr int32_t toInt() const { return _raw >> FRACTION_BITS; }         //Rounds towards minus infinity
+
+    friend constexpr Fixed operator+(Fixed a, Fixed b) { return fromRaw(a._raw + b._raw); }
+    friend constexpr Fixed operator-(Fixed a, Fixed b) { return fromRaw(a._raw - b._raw); }
+    friend constexpr Fixed operator*(Fixed a, Fixed b) { return fromRaw((int32_t)(((int64_t)a._raw * b._raw) >> FRACTION_BITS)); }
+    friend constexpr Fixed operator/(Fixed a, Fixed b) { return fromRaw((int32_t)(((int64_t)a._raw * ONE) / b._raw)); }
+    constexpr Fixed operator-() const { return fromRaw(-_raw); }
+
+    Fixed &operator+=(Fixed other) { _raw += other._raw; return *this; }
+    Fixed &operator-=(Fixed other) { _raw -= other._raw; return *this; }
+    Fixed &operator*=(Fixed other) { return *this = *this * other; }
+    Fixed &operator/=(Fixed other) { return *this = *this / other; }
+
+    friend constexpr bool operator==(Fixed a, Fixed b) { return a._raw == b._raw; }
+    friend constexpr bool operator!=(Fixed a, Fixed b) { return a._raw != b._raw; }
+    friend constexpr bool operator<(Fixed a, Fixed b) { return a._raw < b._raw; }
+    friend constexpr bool operator>(Fixed a, Fixed b) { return a._raw > b._raw; }
+    friend constexpr bool operator<=(Fixed a, Fixed b) { return a._raw <= b._raw; }
+    friend constexpr bool operator>=(Fixed a, Fixed b) { return a._raw >= b._raw; }
+
+private:
+    struct RawTag {};
+    constexpr Fixed(int32_t raw, RawTag) : _raw(raw) {}
+
+    int32_t _raw;
+};
+
+/*
+################################################################################
+Wide fixed-point accumulator
+64-bit sum of Fixed values with the same 16 fractional bits, for totals such
+as odometry that outgrow the Q16.16 range. Adding keeps full resolution no
+matter how large the total gets.
+################################################################################
+*/
+class FixedAccumulator {
+public:
+    constexpr FixedAccumulator() : _raw(0) {}
+    static constexpr FixedAccumulator fromRaw(int64_t raw) { return FixedAccumulator(raw); }
+
+    FixedAccumulator &operator+=(Fixed value) { _raw += value.raw(); return *this; }
+    FixedAccumulator &operator-=(Fixed value) { _raw -= value.raw(); return *this; }
+
+    constexpr int64_t raw() const { return _raw; }
+    constexpr float toFloat() const { return (float)_raw / Fixed::ONE; }
+
+private:
+    explicit constexpr FixedAccumulator(int64_t raw) : _raw(raw) {}
+
+    int64_t _raw;
+};
+
+//Conversions for code that is built with either float or fixed-point values
+inline float toFloat(float value) { return value; }
+inline float toFloat(double value) { return (float)value; }
+inline float toFloat(Fixed value) { return value.toFloat(); }
+inline float toFloat(const FixedAccumulator &value) { return value.toFloat(); }
+
+/*
+Converts a value to a whole number of 1/scale units, e.g. scale 10 gives
+tenths, rounding to nearest and saturating instead of overflowing. Fixed
+values are converted with integer arithmetic only.
+*/
+inline int32_t toScaled(double value, int32_t scale){
+    const double scaled = value * scale;
+    if(scaled >= 2147483647.0) return INT32_MAX;
+    if(scaled <= -2147483647.0) return -INT32_MAX;
+    return (int32_t)(scaled < 0 ? scaled - 0.5 : scaled + 0.5);
+}
+
+inline int32_t toScaled(float value, int32_t scale){
+    const float scaled = value * scale;
+    if(scaled >= 2147483647.0f) return INT32_MAX;
+    if(scaled <= -2147483647.0f) return -INT32_MAX;
+    return (int32_t)(scaled < 0 ? scaled - 0.5f : scaled + 0.5f);
+}
+
+inline int32_t toScaled(const FixedAccumulator &value, int32_t scale){
+    const int64_t half = Fixed::ONE / 2;
+    const int64_t raw = value.raw();
+    const int64_t scaled = (raw * scale + (raw < 0 ? -half : half)) / Fixed::ONE;
+    if(scaled > INT32_MAX) return INT32_MAX;
+    if(scaled < -INT32_MAX) return -INT32_MAX;
+    return (int32_t)scaled;
+}
+
+inline int32_t toScaled(Fixed value, int32_t scale){
+    FixedAccumulator wide;
+    wide += value;
+    return toScaled(wide, scale);
+}
+
+#endif
@@ -0,0 +1,198 @@
+#ifndef FLEET_MODEL_H
+#define FLEET_MODEL_H
+
+#include "CarModel.h"
+#include <stddef.h>
+
+#define FLEET_BLOCK 64                  //Cars taken through all sub-steps together, keeps the working set in L1
+#if defined(__GNUC__)
+#define FLEET_NOINLINE __attribute__((noinline))
+#else
+#define FLEET_NOINLINE
+#endif
+
+/*
+################################################################################
+Fleet model
+Steps N cars at once for the host build, with every quantity in its own
+contiguous array (struct of arrays) so the per-car loops compile to SIMD.
+All cars see the same driver inputs and model parameters but each has its own
+cruise gains, which is what a sweep of controller tunings needs. Each car
+follows exactly the same arithmetic as simulateStep() and cruiseControlStep()
+with a PID from makeCruisePid(), the shared model terms are in CarModel.h.
+The fleet always runs the linear profile, params.profile is not used.
+Meant for the host, a fleet of any useful size does not fit in the target's
+RAM.
+################################################################################
+*/
+template <size_t N>
+struct FleetState {
+    odom_t odometry[N];
+    sim_t speed[N];
+    sim_t accel[N];
+    sim_t brakes[N];
+    uint32_t step;
+    bool ignition;                      //Inputs are shared, so these are the same for every car
+    bool cruise_mode;
+};
+
+template <size_t N>
+struct FleetCommand {
+    sim_t accel[N];
+    sim_t brakes[N];
+    bool engaged;
+};
+
+//Clears the state of every car, the fleet equivalent of VehicleState()
+template <size_t N>
+void resetFleet(FleetState<N> &fleet){
+    for(size_t i = 0; i < N; i++){
+        fleet.odometry[i] = odom_t();
+        fleet.speed[i] = 0;
+        fleet.accel[i] = 0;
+        fleet.brakes[i] = 0;
+    }
+    fleet.step = 0;
+    fleet.ignition = false;
+    fleet.cruise_mode = false;
+}
+
+/*
+################################################################################
+Cruise PID for every car of a fleet, see PidController for the algorithm.
+The control period, derivative filter and output range are shared, gains are
+per car and start at the CRUISE_* defaults.
+################################################################################
+*/
+template <size_t N>
+class FleetCruise {
+public:
+    explicit FleetCruise(uint32_t period_ms)
+        : _period_s(sim_t((int)period_ms) / 1000), _derivative_alpha(_period_s / (sim_t(CRUISE_D_TAU) + _period_s))
+    {
+        for(size_t i = 0; i < N; i++){
+            setGains(i, sim_t(CRUISE_KP), sim_t(CRUISE_KI), sim_t(CRUISE_KD));
+        }
+        reset();
+    }
+
+    void setGains(size_t car, sim_t kp, sim_t ki, sim_t kd){
+        _kp[car] = kp;
+        _ki_dt[car] = ki * _period_s;
+        _kd_dt[car] = kd / _period_s;
+    }
+
+    void reset(){
+        for(size_t i = 0; i < N; i++){
+            _integral[i] = 0;
+            _derivative[i] = 0;
+            _last_measurement[i] = 0;           //Not used until primed, cleared so the branch free loop reads defined values
+        }
+        _primed = false;
+    }
+
+    //Same as cruiseControlStep() for every car
+    void step(const ModelParams &params, const FleetState<N> &state, const DriverInputs &inputs, FleetCommand<N> &command){
+        command.engaged = inputs.cruise_switch && inputs.ignition;
+        if(!command.engaged){
+            reset();
+            for(size_t i = 0; i < N; i++){
+                command.accel[i] = 0;
+                command.brakes[i] = 0;
+            }
+            return;
+        }
+        
+        const sim_t setpoint = params.cruise_speed;
+        const sim_t feed_forward = sim_t(CRUISE_FEED_FORWARD) * params.cruise_speed;
+        const sim_t out_min(-1);
+        const sim_t out_max(1);
+        const bool primed = _primed;
+        for(size_t i = 0; i < N; i++){                          //Branch free so the loop vectorises
+            const sim_t measurement = state.speed[i];
+            const sim_t error = setpoint - measurement;
+            const sim_t raw = (_last_measurement[i] - measurement) * _kd_dt[i];
+            const sim_t derivative = primed ? _derivative[i] + _derivative_alpha * (raw - _derivative[i]) : _derivative[i];
+            _last_measurement[i] = measurement;
+            _derivative[i] = derivative;
+            
+            const sim_t integral = clamp(_integral[i] + _ki_dt[i] * error, out_min, out_max);
+            const sim_t unsaturated = _kp[i] * error + integral + derivative + feed_forward;
+            const sim_t output = clamp(unsaturated, out_min, out_max);
+            const bool winding_up = (unsaturated > out_max && error > 0) || (unsaturated < out_min && error < 0);
+            _integral[i] = winding_up ? _integral[i] : integral;
+            
+            command.accel[i] = output > 0 ? output : sim_t(0);
+            command.brakes[i] = output > 0 ? sim_t(0) : -output;
+        }
+        _primed = true;
+    }
+
+private:
+    static sim_t clamp(sim_t value, sim_t low, sim_t high){
+        return value < low ? low : value > high ? high : value;
+    }
+
+    sim_t _period_s;
+    sim_t _derivative_alpha;
+    sim_t _kp[N];
+    sim_t _ki_dt[N];
+    sim_t _kd_dt[N];
+    sim_t _integral[N];
+    sim_t _derivative[N];
+    sim_t _last_measurement[N];
+    bool _primed;
+};
+
+//One sub-step for a block of cars. Kept out of line, GCC does not vectorise it once inlined into the sub-step loop
+FLEET_NOINLINE inline void integrateBlock(sim_t *speed, sim_t *distance, const sim_t *pedals, size_t count, sim_t h, sim_t max_speed){
+    for(size_t i = 0; i < count; i++){
+        integrate(speed[i], distance[i], pedals[i], h, max_speed);
+    }
+}
+
+/*
+################################################################################
+Same as simulateStep() for every car. Cars are taken FLEET_BLOCK at a time
+through all the sub-steps of dt_us, with the sub-step loop outside the loop
+over cars so the integrator runs across contiguous speeds.
+################################################################################
+*/
+template <size_t N>
+void fleetSimulateStep(FleetState<N> &fleet, const ModelParams &params, const DriverInputs &inputs, const FleetCommand<N> &command, uint32_t dt_us){
+    fleet.ignition = inputs.ignition;
+    fleet.cruise_mode = command.engaged;
+    for(size_t i = 0; i < N; i++){                              //Cruise control or driver drives the pedals
+        const sim_t accel = command.engaged ? command.accel[i] : inputs.accel;
+        fleet.accel[i] = inputs.ignition ? accel : sim_t(0);
+        fleet.brakes[i] = command.engaged ? command.brakes[i] : inputs.brakes;
+    }
+    
+    const uint32_t substep_us = 1000000 / SIM_SUBSTEP_HZ;
+    const sim_t h = secondsFromUs(substep_us);
+    const sim_t h_last = secondsFromUs(dt_us % substep_us);
+    const uint32_t substeps = dt_us / substep_us;
+    const sim_t max_speed = params.max_speed;
+    sim_t pedals[FLEET_BLOCK];
+    sim_t distance[FLEET_BLOCK];
+    for(size_t base = 0; base < N; base += FLEET_BLOCK){
+        const size_t count = N - base < FLEET_BLOCK ? N - base : FLEET_BLOCK;
+        sim_t *speed = &fleet.speed[base];
+        for(size_t i = 0; i < count; i++){
+            pedals[i] = netPedals(fleet.accel[base + i], fleet.brakes[base + i], inputs.ignition);
+            distance[i] = 0;
+        }
+        for(uint32_t n = 0; n < substeps; n++){                 //Fixed sub-steps
+            integrateBlock(speed, distance, pedals, count, h, max_speed);
+        }
+        if(dt_us % substep_us){                                 //Remainder of the step
+            integrateBlock(speed, distance, pedals, count, h_last, max_speed);
+        }
+        for(size_t i = 0; i < count; i++){
+            fleet.odometry[base + i] += distance[i];
+        }
+    }
+    fleet.step++;
+}
+
+#endif
@@ -0,0 +1,81 @@
+#include "HeapGuard.h"
+#include "mbed.h"
+#include <new>
+
+#if HEAP_FREE
+#if MBED_HEAP_STATS_ENABLED
+static uint32_t heap_baseline(0);       //Allocations made by the C library for the Stream drivers
+#endif
+
+static void heapUsed(const char *message){
+    MBED_ERROR(MBED_MAKE_ERROR(MBED_MODULE_APPLICATION, MBED_ERROR_CODE_OUT_OF_MEMORY), message);
+    while(true){}                                       //Fatal error does not return
+}
+
+void *operator new(std::size_t){
+    heapUsed("operator new in a HEAP_FREE build");
+    return NULL;
+}
+
+void *operator new[](std::size_t){
+    heapUsed("operator new[] in a HEAP_FREE build");
+    return NULL;
+}
+
+void *operator new(std::size_t, const std::nothrow_t &){
+    heapUsed("operator new in a HEAP_FREE build");
+    return NULL;
+}
+
+void *operator new[](std::size_t, const std::nothrow_t &){
+    heapUsed("operator new[] in a HEAP_FREE build");
+    return NULL;
+}
+
+//Nothing can come from the new above, so deleting anything but NULL means it came from the library's operator new
+void operator delete(void *pointer){
+    if(pointer) heapUsed("operator delete in a HEAP_FREE build");
+}
+
+void operator delete[](void *pointer){
+    if(pointer) heapUsed("operator delete[] in a HEAP_FREE build");
+}
+
+void operator delete(void *pointer, std::size_t){
+    if(pointer) heapUsed("operator delete in a HEAP_FREE build");
+}
+
+void operator delete[](void *pointer, std::size_t){
+    if(pointer) heapUsed("operator delete[] in a HEAP_FREE build");
+}
+
+void operator delete(void *pointer, const std::nothrow_t &){
+    if(pointer) heapUsed("operator delete in a HEAP_FREE build");
+}
+
+void operator delete[](void *pointer, const std::nothrow_t &){
+    if(pointer) heapUsed("operator delete[] in a HEAP_FREE build");
+}
+
+void markHeapBaseline(){
+#if MBED_HEAP_STATS_ENABLED
+    mbed_stats_heap_t heap;
+    mbed_stats_heap_get(&heap);
+    heap_baseline = heap.alloc_cnt;
+#endif
+}
+
+void checkHeapUnused(){
+#if MBED_HEAP_STATS_ENABLED
+    mbed_stats_heap_t heap;
+    mbed_stats_heap_get(&heap);
+    if(heap.alloc_cnt != heap_baseline) heapUsed("malloc in a HEAP_FREE build");
+#endif
+}
+#else
+void markHeapBaseline(){
+}
+
+void checkHeapUnused(){
+}
+#endif
@@ -0,0 +1,26 @@
+#ifndef HEAP_GUARD_H
+#define HEAP_GUARD_H
+
+#ifndef HEAP_FREE
+#define HEAP_FREE 0                     //Set to 1 to make any heap allocation a fatal error
+#endif
+
+/*
+################################################################################
+Heap guard
+Every object, queue and thread stack in this program is statically
+allocated, and the flash is written through InternalFlash, which unlike
+FlashIAP keeps no heap page buffer. With HEAP_FREE the global operator new
+and delete are replaced by ones that stop with a fatal error, so any
+allocation from C++ code is caught the first time it happens instead of
+slowly fragmenting the heap.
+The C library still allocates: the LCD driver is a Stream, and opening a
+Stream makes newlib malloc() a FILE. When heap statistics are enabled
+markHeapBaseline() records the allocations made so far once those drivers
+are built, and checkHeapUnused() catches any malloc() from C code after it.
+################################################################################
+*/
+void markHeapBaseline();                //Call once the Stream based drivers are built
+void checkHeapUnused();                 //Call once everything is started, fatal error if the heap was used since the baseline
+
+#endif
@@ -0,0 +1,152 @@
+#include "HilBench.h"
+#include "CycleCounter.h"
+
+#define HIL_RUN_FLAG 0x1                //Thread flag set by run()
+#define HIL_RESPONSE_FLAG 0x2           //Thread flag set by output() when an edge got its response
+#define HIL_NO_EDGE -1
+
+//Input and cruise task periods of each sweep, from the firmware's rates to four times them
+static const uint32_t sweep_periods[HIL_MAX_SWEEPS][2] = {
+    {40, 50},
+    {20, 50},
+    {20, 25},
+    {10, 25},
+};
+
+static const char *path_names[HIL_PATHS] = {"switch>engine", "switch>cruise", "frame>lcd"};
+
+void LatencyHistogram::reset(){
+    memset(this, 0, sizeof(*this));
+    min_us = UINT32_MAX;
+}
+
+void LatencyHistogram::add(uint32_t us){
+    int bin = 0;
+    uint32_t edge = HIL_FIRST_BIN_US;
+    while(us >= edge && bin < HIL_BINS - 1){
+        edge <<= 1;
+        bin++;
+    }
+    bins[bin]++;
+    count++;
+    total_us += us;
+    if(us < min_us) min_us = us;
+    if(us > max_us) max_us = us;
+}
+
+HilBench::HilBench(const ThreadConfig &config, PinName engine_pin, PinName cruise_pin, PeriodicTask *input, PeriodicTask &cruise)
+    : _config(config), _thread(config.priority, config.stack_size, config.stack, config.name), _engine_pin(engine_pin, 0), _cruise_pin(cruise_pin, 0),
+      _input(input), _cruise(cruise), _results(0), _current(0), _running(false), _lcg(12345)
+{
+    for(int i = 0; i <= HIL_CRUISE_LED; i++){
+        _expected[i] = HIL_NO_EDGE;
+        _stimulus_at[i] = 0;
+        _response_us[i] = 0;
+    }
+}
+
+void HilBench::start(){
+    prepareStack(_config);
+    _thread.start(callback(this, &HilBench::runBench));
+}
+
+bool HilBench::run(){
+    if(_running) return false;
+    _running = true;
+    _thread.flags_set(HIL_RUN_FLAG);
+    return true;
+}
+
+const char *HilBench::pathName(int path){
+    return path >= 0 && path < HIL_PATHS ? path_names[path] : "";
+}
+
+void HilBench::output(HilPath path, bool level){
+    if(_expected[path] != (int)level) return;           //Nothing waiting, costs a load and a compare
+    const uint32_t now = CycleCounter::now();
+    _expected[path] = HIL_NO_EDGE;
+    _response_us[path] = CycleCounter::toUs(now - _stimulus_at[path]);
+    _thread.flags_set(HIL_RESPONSE_FLAG);
+}
+
+void HilBench::frameShown(uint32_t posted){
+    if(!_running) return;
+    _result[_current].paths[HIL_LCD_FRAME].add(CycleCounter::toUs(CycleCounter::now() - posted));  //Only the input task adds to this path
+}
+
+uint32_t HilBench::totalOverruns() const {
+    uint32_t overruns(0);
+    for(size_t i = 0; i < PeriodicTask::count(); i++){
+        overruns += PeriodicTask::get(i)->overruns();
+    }
+    return overruns;
+}
+
+uint32_t HilBench::gapMs(){
+    _lcg = _lcg * 1664525u + 1013904223u;
+    return HIL_GAP_MS + ((_lcg >> 16) & (HIL_JITTER_MS - 1));
+}
+
+void HilBench::edge(HilPath path, DigitalOut &pin, int level, LatencyHistogram &histogram){
+    ThisThread::flags_clear(HIL_RESPONSE_FLAG);
+    core_util_critical_section_enter();                 //Stamp and edge together, nothing can run in between
+    _stimulus_at[path] = CycleCounter::now();
+    pin = level;
+    _expected[path] = level;
+    core_util_critical_section_exit();
+    
+    if(ThisThread::flags_wait_any_for(HIL_RESPONSE_FLAG, HIL_TIMEOUT_MS) & HIL_RESPONSE_FLAG){
+        histogram.add(_response_us[path]);
+    }
+    else{
+        _expected[path] = HIL_NO_EDGE;
+        histogram.lost++;
+    }
+    ThisThread::sleep_for(gapMs());
+}
+
+void HilBench::sweep(HilResult &result){
+    if(_input) _input->setPeriod(result.input_ms);
+    _cruise.setPeriod(result.cruise_ms);
+    _engine_pin = 0;
+    _cruise_pin = 0;
+    ThisThread::sleep_for(HIL_SETTLE_MS);
+    const uint32_t overruns = totalOverruns();
+    
+    for(int i = 0; i < HIL_EDGES; i++){                 //Ignition on and off
+        edge(HIL_ENGINE_LED, _engine_pin, !(i & 1), result.paths[HIL_ENGINE_LED]);
+    }
+    _engine_pin = 1;                                    //Cruise control only engages with the ignition on
+    ThisThread::sleep_for(HIL_SETTLE_MS);
+    for(int i = 0; i < HIL_EDGES; i++){
+        edge(HIL_CRUISE_LED, _cruise_pin, !(i & 1), result.paths[HIL_CRUISE_LED]);
+    }
+    _cruise_pin = 0;
+    _engine_pin = 0;
+    
+    result.overruns = totalOverruns() - overruns;
+}
+
+void HilBench::runBench(){
+    while(true){
+        ThisThread::flags_wait_any(HIL_RUN_FLAG);
+        const uint32_t input_ms = _input ? _input->period_ms() : 0;
+        const uint32_t cruise_ms = _cruise.period_ms();
+        _results = 0;
+        for(size_t i = 0; i < HIL_MAX_SWEEPS; i++){
+            HilResult &result = _result[i];
+            for(int path = 0; path < HIL_PATHS; path++){
+                result.paths[path].reset();
+            }
+            result.input_ms = _input ? sweep_periods[i][0] : 0;
+            result.cruise_ms = sweep_periods[i][1];
+            result.overruns = 0;
+            _current = i;
+            sweep(result);
+            _results = i + 1;
+        }
+        if(_input) _input->setPeriod(input_ms);         //Back to the rates from the thread table
+        _cruise.setPeriod(cruise_ms);
+        _running = false;
+    }
+}
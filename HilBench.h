@@ -0,0 +1,104 @@
+#ifndef HIL_BENCH_H
+#define HIL_BENCH_H
+
+#include "mbed.h"
+#include "PeriodicTask.h"
+#include "ThreadConfig.h"
+
+#define HIL_BINS 12                     //Histogram bins, the last one also counts everything above it
+#define HIL_FIRST_BIN_US 128            //Upper edge of the first bin, every further bin doubles
+#define HIL_MAX_SWEEPS 4
+#define HIL_EDGES 32                    //Stimulus edges per LED path per sweep
+#define HIL_TIMEOUT_MS 1000             //Longest wait for a response before the edge counts as lost
+#define HIL_SETTLE_MS 500               //Time for the pipeline to settle after changing rates or inputs
+#define HIL_GAP_MS 60                   //Least time between edges, a pseudo random part up to HIL_JITTER_MS is added
+#define HIL_JITTER_MS 64                //Power of two, spreads the edges over the task phases
+
+enum HilPath {
+    HIL_ENGINE_LED,                     //Ignition switch to engine indicator, input task only
+    HIL_CRUISE_LED,                     //Cruise switch to cruise indicator, input and cruise tasks
+    HIL_LCD_FRAME,                      //Display task posting a frame to its last character on the LCD
+    HIL_PATHS
+};
+
+//Log2 histogram of latencies in microseconds
+struct LatencyHistogram {
+    uint32_t bins[HIL_BINS];
+    uint32_t count;
+    uint32_t lost;                      //Edges with no response within HIL_TIMEOUT_MS
+    uint32_t min_us;
+    uint32_t max_us;
+    uint64_t total_us;
+
+    void reset();
+    void add(uint32_t us);
+    uint32_t meanUs() const { return count ? (uint32_t)(total_us / count) : 0; }
+};
+
+//Task rates for one sweep, and what was measured at them
+struct HilResult {
+    uint32_t input_ms;                  //0 with INPUT_INTERRUPT, the input task is then event driven
+    uint32_t cruise_ms;
+    uint32_t overruns;                  //Deadlines missed by all periodic tasks during the sweep
+    LatencyHistogram paths[HIL_PATHS];
+};
+
+/*
+################################################################################
+Hardware-in-the-loop latency benchmark
+Two spare GPIOs are wired to the ignition and cruise switch inputs of the
+expander (with the switches off), so the stimulus goes through the real I2C
+read. The bench thread flips a pin and takes a cycle counter stamp in the
+same critical section, and the task that writes the matching LED calls
+output() right where it does so, which stamps the response. LCD frames are
+timed from the display task's post to the flush that writes their last
+character. Each sweep sets the input and cruise task periods from a table,
+flips each switch HIL_EDGES times with pseudo random gaps so the edges land
+at every task phase, and collects a histogram per path along with the
+overruns of all periodic tasks. The original periods are restored at the
+end. The cruise task rebuilds its PID whenever its period changes, so each
+sweep runs the gains discretised for its rate, and the firmware's own gains
+are back once the periods are restored. Only built with HIL_BENCH.
+################################################################################
+*/
+class HilBench {
+public:
+    HilBench(const ThreadConfig &config, PinName engine_pin, PinName cruise_pin, PeriodicTask *input, PeriodicTask &cruise);
+
+    void start();                       //Start the bench thread, it waits for run()
+    bool run();                         //Start the sweeps, false if they are already running
+    bool running() const { return _running; }
+
+    void output(HilPath path, bool level);  //An LED was written, called by the task writing it
+    void frameShown(uint32_t posted);   //A frame posted at cycle counter time posted is now fully on the LCD
+
+    size_t results() const { return _results; }     //Sweeps completed by the last run
+    const HilResult &result(size_t index) const { return _result[index]; }
+    const Thread &thread() const { return _thread; }
+
+    static const char *pathName(int path);
+
+private:
+    void runBench();
+    void sweep(HilResult &result);
+    void edge(HilPath path, DigitalOut &pin, int level, LatencyHistogram &histogram);
+    uint32_t totalOverruns() const;
+    uint32_t gapMs();
+
+    const ThreadConfig &_config;
+    Thread _thread;
+    DigitalOut _engine_pin;
+    DigitalOut _cruise_pin;
+    PeriodicTask *_input;               //NULL with INPUT_INTERRUPT
+    PeriodicTask &_cruise;
+    HilResult _result[HIL_MAX_SWEEPS];
+    volatile size_t _results;
+    volatile size_t _current;           //Sweep being measured
+    volatile bool _running;
+    volatile int _expected[HIL_CRUISE_LED + 1];     //LED level an edge is waiting for, -1 if none
+    volatile uint32_t _stimulus_at[HIL_CRUISE_LED + 1];
+    volatile uint32_t _response_us[HIL_CRUISE_LED + 1];
+    uint32_t _lcg;
+};
+
+#endif
@@ -0,0 +1,101 @@
+#include "InputTrace.h"
+#include <string.h>
+
+static const uint8_t trace_magic[TRACE_MAGIC_SIZE] = {'T', 'R', 'C', '1'};
+
+#define TRACE_MAX_EVENT 7               //5 byte varint and the snapshot
+
+TraceWriter::TraceWriter(uint8_t *buffer, size_t capacity) : _buffer(buffer), _capacity(capacity)
+{
+    reset();
+}
+
+void TraceWriter::reset(){
+    _size = 0;
+    _events = 0;
+    _last_time_ms = 0;
+    _last_snapshot = 0;
+    _full = _capacity < TRACE_MAGIC_SIZE;
+    if(_full) return;
+    memcpy(_buffer, trace_magic, TRACE_MAGIC_SIZE);
+    _size = TRACE_MAGIC_SIZE;
+}
+
+bool TraceWriter::append(uint32_t time_ms, uint16_t snapshot){
+    if(_events > 0 && snapshot == _last_snapshot) return !_full;   //Only changes are stored
+    return store(time_ms, snapshot);
+}
+
+bool TraceWriter::finish(uint32_t time_ms){
+    return _events == 0 || store(time_ms, _last_snapshot);
+}
+
+bool TraceWriter::store(uint32_t time_ms, uint16_t snapshot){
+    if(_full) return false;
+    if(_capacity - _size < TRACE_MAX_EVENT){
+        _full = true;
+        return false;
+    }
+    
+    uint32_t delta = time_ms - _last_time_ms;
+    while(delta >= 0x80){
+        _buffer[_size++] = (delta & 0x7F) | 0x80;
+        delta >>= 7;
+    }
+    _buffer[_size++] = delta;
+    _buffer[_size++] = snapshot;
+    _buffer[_size++] = snapshot >> 8;
+    
+    _last_time_ms = time_ms;
+    _last_snapshot = snapshot;
+    _events++;
+    return true;
+}
+
+TraceReader::TraceReader(const uint8_t *data, size_t size) : _data(data), _size(size)
+{
+    _valid = size >= TRACE_MAGIC_SIZE && memcmp(data, trace_magic, TRACE_MAGIC_SIZE) == 0;
+    rewind();
+}
+
+void TraceReader::rewind(){
+    _position = TRACE_MAGIC_SIZE;
+    _time_ms = 0;
+}
+
+bool TraceReader::next(TraceEvent &event){
+    if(!_valid) return false;
+    size_t position = _position;
+    uint32_t delta = 0;
+    for(int shift = 0; ; shift += 7){
+        if(position >= _size || shift > 28) return false;
+        const uint8_t byte = _data[position++];
+        delta |= (uint32_t)(byte & 0x7F) << shift;
+        if(!(byte & 0x80)) break;
+    }
+    if(_size - position < 2) return false;
+    event.snapshot = _data[position] | (_data[position + 1] << 8);
+    _time_ms += delta;
+    event.time_ms = _time_ms;
+    _position = position + 2;
+    return true;
+}
+
+TracePlayer::TracePlayer(const uint8_t *data, size_t size, uint16_t initial)
+    : _reader(data, size), _snapshot(initial), _end_ms(0)
+{
+    TraceEvent event;
+    while(_reader.next(event)){                         //Find the length once, traces are small
+        _end_ms = event.time_ms;
+    }
+    _reader.rewind();
+    _finished = !_reader.next(_pending);
+}
+
+uint16_t TracePlayer::at(uint32_t time_ms){
+    while(!_finished && _pending.time_ms <= time_ms){
+        _snapshot = _pending.snapshot;
+        _finished = !_reader.next(_pending);
+    }
+    return _snapshot;
+}
@@ -0,0 +1,91 @@
+#ifndef INPUT_TRACE_H
+#define INPUT_TRACE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define TRACE_MAGIC_SIZE 4              //Bytes of "TRC1" at the start of every trace
+
+//Port snapshot and the time it was read, in ms from the start of the trace
+struct TraceEvent {
+    uint32_t time_ms;
+    uint16_t snapshot;
+};
+
+/*
+################################################################################
+Input trace
+Compact binary record of the port snapshots seen by the input task. A trace
+is "TRC1" followed by one event per change of the snapshot: the time since
+the previous event in ms as a base-128 varint (low 7 bits first, top bit set
+on all but the last byte), then the 16-bit snapshot, low byte first. An
+unchanged snapshot costs nothing, a change a few times a second costs 3 or 4
+bytes. The code has no hardware dependencies and builds for the host replay
+(see host/).
+################################################################################
+*/
+class TraceWriter {
+public:
+    TraceWriter(uint8_t *buffer, size_t capacity);
+
+    void reset();                       //Start a new, empty trace
+    bool append(uint32_t time_ms, uint16_t snapshot);  //Adds an event if the snapshot changed, false once the buffer is full
+    bool finish(uint32_t time_ms);      //Repeats the last snapshot at time_ms so a replay lasts as long as the recording
+
+    const uint8_t *data() const { return _buffer; }
+    size_t size() const { return _size; }
+    uint32_t events() const { return _events; }
+    bool full() const { return _full; }
+
+private:
+    bool store(uint32_t time_ms, uint16_t snapshot);
+
+    uint8_t *_buffer;
+    size_t _capacity;
+    size_t _size;
+    uint32_t _events;
+    uint32_t _last_time_ms;
+    uint16_t _last_snapshot;
+    bool _full;
+};
+
+class TraceReader {
+public:
+    TraceReader(const uint8_t *data, size_t size);
+
+    bool valid() const { return _valid; }   //Starts with the trace magic
+    bool next(TraceEvent &event);           //False at the end of the trace or on a truncated event
+    void rewind();
+
+private:
+    const uint8_t *_data;
+    size_t _size;
+    size_t _position;
+    uint32_t _time_ms;
+    bool _valid;
+};
+
+/*
+################################################################################
+Plays a trace back against a clock. at() returns the snapshot in effect at a
+time, times must not go backwards. Before the first event the snapshot is
+initial, after the last event it keeps the last snapshot.
+################################################################################
+*/
+class TracePlayer {
+public:
+    TracePlayer(const uint8_t *data, size_t size, uint16_t initial = 0);
+
+    uint16_t at(uint32_t time_ms);
+    bool finished() const { return _finished; }     //Every event has been played
+    uint32_t endMs() const { return _end_ms; }      //Time of the last event
+
+private:
+    TraceReader _reader;
+    TraceEvent _pending;                //Next event to play
+    uint16_t _snapshot;
+    uint32_t _end_ms;
+    bool _finished;
+};
+
+#endif
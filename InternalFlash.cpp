@@ -0,0 +1,103 @@
+#include "InternalFlash.h"
+
+InternalFlash::InternalFlash() : _ready(false)
+{
+}
+
+#if DEVICE_FLASH
+bool InternalFlash::init(){
+    if(!_ready) _ready = flash_init(&_flash) == 0;
+    return _ready;
+}
+
+bool InternalFlash::read(void *buffer, uint32_t address, uint32_t size){
+    if(!_ready) return false;
+    _mutex.lock();
+    const bool ok = flash_read(&_flash, address, (uint8_t *)buffer, size) == 0;
+    _mutex.unlock();
+    return ok;
+}
+
+bool InternalFlash::program(const void *buffer, uint32_t address, uint32_t size){
+    const uint32_t page_size = pageSize();
+    if(!_ready || ((uintptr_t)buffer & 3) || address % page_size || size % page_size) return false;
+    const uint8_t *data = (const uint8_t *)buffer;
+    bool ok = true;
+    _mutex.lock();
+    for(uint32_t offset = 0; ok && offset < size; offset += page_size){
+        ok = flash_program_page(&_flash, address + offset, data + offset, page_size) == 0;
+    }
+    _mutex.unlock();
+    return ok;
+}
+
+bool InternalFlash::erase(uint32_t address, uint32_t size){
+    if(!_ready) return false;                           //address has to be the start of a sector
+    const uint32_t end = address + size;
+    bool ok = true;
+    _mutex.lock();
+    while(ok && address < end){                         //Sectors differ in size, walk them one at a time
+        const uint32_t sector = flash_get_sector_size(&_flash, address);
+        ok = sector != MBED_FLASH_INVALID_SIZE && flash_erase_sector(&_flash, address) == 0;
+        address += sector;
+    }
+    _mutex.unlock();
+    return ok && address == end;                        //Stopping past the end means size was not whole sectors
+}
+
+uint32_t InternalFlash::start() const {
+    return flash_get_start_address(&_flash);
+}
+
+uint32_t InternalFlash::size() const {
+    return flash_get_size(&_flash);
+}
+
+uint32_t InternalFlash::sectorSize(uint32_t address) const {
+    return flash_get_sector_size(&_flash, address);
+}
+
+uint32_t InternalFlash::pageSize() const {
+    return flash_get_page_size(&_flash);
+}
+
+uint8_t InternalFlash::eraseValue() const {
+    return flash_get_erase_value(&_flash);
+}
+#else
+bool InternalFlash::init(){
+    return false;                                       //No internal flash on this target
+}
+
+bool InternalFlash::read(void *, uint32_t, uint32_t){
+    return false;
+}
+
+bool InternalFlash::program(const void *, uint32_t, uint32_t){
+    return false;
+}
+
+bool InternalFlash::erase(uint32_t, uint32_t){
+    return false;
+}
+
+uint32_t InternalFlash::start() const {
+    return 0;
+}
+
+uint32_t InternalFlash::size() const {
+    return 0;
+}
+
+uint32_t InternalFlash::sectorSize(uint32_t) const {
+    return 0;
+}
+
+uint32_t InternalFlash::pageSize() const {
+    return 1;
+}
+
+uint8_t InternalFlash::eraseValue() const {
+    return 0xFF;
+}
+#endif
@@ -0,0 +1,48 @@
+#ifndef INTERNAL_FLASH_H
+#define INTERNAL_FLASH_H
+
+#include "mbed.h"
+#if DEVICE_FLASH
+#include "hal/flash_api.h"
+#endif
+
+#define FLASH_ERASE_STALL_MS 100        //LPC1768 IAP sector erase, the CPU and all interrupts stop for this long
+
+/*
+################################################################################
+Internal flash
+Thin layer over the mbed flash HAL shared by the parameter store and the trip
+log. It is initialised once in main() and never freed. Unlike FlashIAP it
+keeps no page buffer, FlashIAP::init() takes one from the heap, so program()
+only accepts word aligned buffers in RAM whose size is a whole number of
+pages, and erase() whole sectors. A mutex keeps the console and trip logger
+threads from using the flash at the same time. On the LPC1768 every erase
+and program runs through IAP, which stops the CPU, see TripLog.
+################################################################################
+*/
+class InternalFlash {
+public:
+    InternalFlash();
+
+    bool init();                        //Call once before any other use, false if there is no usable flash
+    bool ready() const { return _ready; }
+
+    bool read(void *buffer, uint32_t address, uint32_t size);
+    bool program(const void *buffer, uint32_t address, uint32_t size);
+    bool erase(uint32_t address, uint32_t size);
+
+    uint32_t start() const;             //Address of the first byte
+    uint32_t size() const;
+    uint32_t sectorSize(uint32_t address) const;    //Size of the sector holding address
+    uint32_t pageSize() const;
+    uint8_t eraseValue() const;
+
+private:
+#if DEVICE_FLASH
+    flash_t _flash;
+#endif
+    Mutex _mutex;
+    bool _ready;
+};
+
+#endif
@@ -0,0 +1,62 @@
+#include "LcdFrameBuffer.h"
+#include "FixedFormat.h"
+
+#define GLASS_UNKNOWN 0                 //Never written as a character, forces a rewrite
+
+LcdFrameBuffer::LcdFrameBuffer(WattBob_TextLCD *lcd) : _lcd(lcd)
+{
+    memset(_shadow.text, ' ', sizeof(_shadow.text));
+    invalidate();
+}
+
+void LcdFrameBuffer::clearRow(int row){
+    if(row < 0 || row >= LCD_ROWS) return;
+    memset(_shadow.text[row], ' ', LCD_COLUMNS);
+}
+
+void LcdFrameBuffer::print(int row, int column, const char *text){
+    if(row < 0 || row >= LCD_ROWS || column < 0) return;
+    while(column < LCD_COLUMNS && *text){
+        _shadow.text[row][column++] = *text++;
+    }
+}
+
+void LcdFrameBuffer::printFixed(int row, int column, int width, int32_t value, int decimals){
+    if(row < 0 || row >= LCD_ROWS || column < 0 || column + width > LCD_COLUMNS) return;
+    formatFixed(&_shadow.text[row][column], width, value, decimals);
+}
+
+void LcdFrameBuffer::cleared(){
+    memset(_glass, ' ', sizeof(_glass));
+}
+
+void LcdFrameBuffer::invalidate(){
+    memset(_glass, GLASS_UNKNOWN, sizeof(_glass));
+}
+
+bool LcdFrameBuffer::pending() const{
+    if(_lcd == NULL) return false;
+    return memcmp(_shadow.text, _glass, sizeof(_glass)) != 0;
+}
+
+size_t LcdFrameBuffer::flush(size_t budget){
+    size_t written(0);
+    if(_lcd == NULL) return 0;                      //Formatting only buffer
+    for(int row = 0; row < LCD_ROWS; row++){
+        int column = 0;
+        while(column < LCD_COLUMNS && written < budget){
+            if(_shadow.text[row][column] == _glass[row][column]){
+                column++;
+                continue;
+            }
+            _lcd->locate(row, column);              //Start of a changed run
+            while(column < LCD_COLUMNS && written < budget && _shadow.text[row][column] != _glass[row][column]){
+                _lcd->putc(_shadow.text[row][column]);
+                _glass[row][column] = _shadow.text[row][column];
+                column++;
+                written++;
+            }
+        }
+    }
+    return written;
+}
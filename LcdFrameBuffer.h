@@ -0,0 +1,54 @@
+#ifndef LCD_FRAME_BUFFER_H
+#define LCD_FRAME_BUFFER_H
+
+#include "WattBob_TextLCD.h"
+#include "mbed.h"
+
+#define LCD_ROWS 2
+#define LCD_COLUMNS 16
+#define LCD_FLUSH_ALL (LCD_ROWS * LCD_COLUMNS)  //Budget that always writes the whole difference
+
+//Contents of the whole display, small enough to pass between tasks by value
+struct LcdFrame {
+    char text[LCD_ROWS][LCD_COLUMNS];
+};
+
+/*
+################################################################################
+LCD frame buffer
+Text is formatted into a 2*16 shadow buffer, which is compared with a copy of
+what is currently shown on the LCD. Flushing only sends the runs of
+characters that changed, so an update where only the last odometer digit
+moved costs one locate and one character instead of the whole display.
+Formatting does not touch the LCD, only flush() needs the shared port, and
+numbers are formatted with integer arithmetic so float printf is not needed.
+A buffer made without an LCD is only used for formatting, its frame() can be
+handed to the buffer that owns the LCD with load().
+Every character is several blocking I2C transfers through the expander, so
+flush() takes a budget of characters and leaves the rest for the next call.
+A frame loaded before the rest is written simply replaces it, only what
+still differs from the glass is sent.
+################################################################################
+*/
+class LcdFrameBuffer {
+public:
+    LcdFrameBuffer(WattBob_TextLCD *lcd = NULL);
+
+    void clearRow(int row);             //Fill a row of the shadow buffer with spaces
+    void print(int row, int column, const char *text);  //Copy text into the shadow buffer, clipped to the row
+    void printFixed(int row, int column, int width, int32_t value, int decimals);   //Format a fixed-point value, see formatFixed()
+    void cleared();                     //LCD has been cleared, glass now holds spaces
+    void invalidate();                  //Contents of the LCD are unknown, next flush rewrites everything
+    size_t flush(size_t budget = LCD_FLUSH_ALL);    //Write up to budget changed characters to the LCD, returns number written
+    bool pending() const;               //Some characters still differ from the LCD
+
+    const LcdFrame &frame() const { return _shadow; }
+    void load(const LcdFrame &frame) { _shadow = frame; }  //Replace the whole shadow buffer
+
+private:
+    WattBob_TextLCD *_lcd;
+    LcdFrame _shadow;                               //What should be on the LCD
+    char _glass[LCD_ROWS][LCD_COLUMNS];             //What is on the LCD
+};
+
+#endif
@@ -0,0 +1,73 @@
+#ifndef MAILBOX_H
+#define MAILBOX_H
+
+#include "DoubleBuffer.h"
+#include "CycleCounter.h"
+#include "StageLatency.h"
+
+//Message with the cycle counter value it was posted at
+template <typename T>
+struct Stamped {
+    T value;
+    uint32_t stamp;
+};
+
+template <typename T>
+inline Stamped<T> stamped(const T &value){
+    Stamped<T> message;
+    message.value = value;
+    message.stamp = CycleCounter::now();
+    return message;
+}
+
+/*
+################################################################################
+Latest-value mailbox between two pipeline stages
+The producing stage posts, consuming stages take a copy of the newest message
+without waiting, see DoubleBuffer. Messages carry the time they were posted,
+receive() adds their age to the consumer's stage latency.
+################################################################################
+*/
+template <typename T>
+class Mailbox {
+public:
+    Mailbox() {}
+    explicit Mailbox(const T &initial) : _buffer(stamped(initial)) {}
+
+    void post(const T &value){ _buffer.publish(stamped(value)); }
+
+    //Newest message, without counting it towards a stage latency
+    T read() const { return _buffer.read().value; }
+
+    //Newest message, its age is added to latency
+    T receive(StageLatency &latency) const {
+        const Stamped<T> message = _buffer.read();
+        latency.record(message.stamp);
+        return message.value;
+    }
+
+    //Only takes the newest message if it was posted after the one last seen, returns false otherwise
+    //The message keeps its stamp, for consumers that time what they do with it
+    bool receiveNew(uint32_t &seen, Stamped<T> &out, StageLatency &latency) const {
+        const uint32_t sequence = _buffer.sequence();
+        if(sequence == seen) return false;
+        seen = sequence;                                //A post after this point is picked up next time
+        out = _buffer.read();
+        latency.record(out.stamp);
+        return true;
+    }
+
+    bool receiveNew(uint32_t &seen, T &out, StageLatency &latency) const {
+        Stamped<T> message;
+        if(!receiveNew(seen, message, latency)) return false;
+        out = message.value;
+        return true;
+    }
+
+    uint32_t sequence() const { return _buffer.sequence(); }
+
+private:
+    DoubleBuffer<Stamped<T> > _buffer;
+};
+
+#endif
@@ -0,0 +1,102 @@
+#include "ParameterStore.h"
+#include "CarModel.h"
+#include "Crc.h"
+
+#define PARAM_RECORD_MAGIC 0x314D5250   //"PRM1"
+#define PARAM_FLASH_BUFFER 512          //Largest flash page size supported
+
+static const ParamInfo param_table[PARAM_COUNT] = {
+    {"cruise_speed", CRUISE_SPEED, MIN_SPEED, MAX_SPEED},
+    {"cruise_step", 5, 0.5f, 50},
+    {"legal_speed", LEGAL_SPEED, MIN_SPEED, MAX_SPEED},
+    {"max_speed", MAX_SPEED, 1, MAX_SPEED},
+    {"cruise_kp", CRUISE_KP, 0, 10},
+    {"cruise_ki", CRUISE_KI, 0, 10},
+    {"cruise_kd", CRUISE_KD, 0, 10},
+    {"profile", VEHICLE_PROFILE, 0, PROFILE_COUNT - 1},
+    {"speeding_hyst", 2, 0, 20},
+    {"speeding_hold", 1, 0, 10},
+};
+
+//Layout of the parameters in flash
+struct ParamRecord {
+    uint32_t magic;
+    uint32_t count;
+    float values[PARAM_COUNT];
+    uint32_t crc;                       //CRC-32 of everything before it
+};
+
+ParameterStore::ParameterStore(InternalFlash &flash) : _flash(flash), _stall_handler(NULL), _revision(0)
+{
+    restoreDefaults();
+}
+
+bool ParameterStore::set(ParamId id, float value){
+    if(id >= PARAM_COUNT) return false;
+    if(!(value >= param_table[id].min && value <= param_table[id].max)) return false;    //Also rejects NaN
+    _values[id] = value;
+    _revision.fetch_add(1, std::memory_order_release);
+    return true;
+}
+
+void ParameterStore::restoreDefaults(){
+    for(int i = 0; i < PARAM_COUNT; i++){
+        _values[i] = param_table[i].value_default;
+    }
+    _revision.fetch_add(1, std::memory_order_release);
+}
+
+const ParamInfo &ParameterStore::info(ParamId id){
+    return param_table[id];
+}
+
+int ParameterStore::find(const char *name){
+    for(int i = 0; i < PARAM_COUNT; i++){
+        if(strcmp(param_table[i].name, name) == 0) return i;
+    }
+    return -1;
+}
+
+//Last sector of internal flash, well clear of the firmware
+static uint32_t paramSectorAddress(const InternalFlash &flash){
+    const uint32_t end = flash.start() + flash.size();
+    return end - flash.sectorSize(end - 1);
+}
+
+bool ParameterStore::load(){
+    ParamRecord record;
+    const bool read = _flash.read(&record, paramSectorAddress(_flash), sizeof(record));
+
+    if(!read || record.magic != PARAM_RECORD_MAGIC || record.count != PARAM_COUNT
+       || record.crc != crc32(&record, offsetof(ParamRecord, crc))){
+        return false;                                   //Nothing saved yet, or saved by a different layout
+    }
+    for(int i = 0; i < PARAM_COUNT; i++){
+        set((ParamId)i, record.values[i]);              //Out of range values keep their current value
+    }
+    return true;
+}
+
+bool ParameterStore::save(){
+    MBED_ALIGN(4) static uint8_t page[PARAM_FLASH_BUFFER];  //Programming works on whole pages
+    ParamRecord record;
+    record.magic = PARAM_RECORD_MAGIC;
+    record.count = PARAM_COUNT;
+    for(int i = 0; i < PARAM_COUNT; i++){
+        record.values[i] = _values[i];
+    }
+    record.crc = crc32(&record, offsetof(ParamRecord, crc));
+
+    if(!_flash.ready()) return false;
+    const uint32_t address = paramSectorAddress(_flash);
+#ifdef FLASHIAP_APP_ROM_END_ADDR
+    if(address < FLASHIAP_APP_ROM_END_ADDR) return false;  //Never erase the firmware
+#endif
+    const uint32_t page_size = _flash.pageSize();
+    const uint32_t size = (sizeof(record) + page_size - 1) / page_size * page_size;
+    if(size > sizeof(page)) return false;
+    memset(page, _flash.eraseValue(), size);
+    memcpy(page, &record, sizeof(record));
+    if(_stall_handler) _stall_handler(FLASH_ERASE_STALL_MS);
+    return _flash.erase(address, _flash.sectorSize(address)) && _flash.program(page, address, size);
+}
@@ -0,0 +1,64 @@
+#ifndef PARAMETER_STORE_H
+#define PARAMETER_STORE_H
+
+#include "mbed.h"
+#include "InternalFlash.h"
+#include <atomic>
+
+//Runtime parameters, the order is also the layout of the saved record
+enum ParamId {
+    PARAM_CRUISE_SPEED,                 //Cruise control set speed in km/h
+    PARAM_CRUISE_STEP,                  //Set speed change per adjust command
+    PARAM_LEGAL_SPEED,                  //Average speed that lights the speeding indicator
+    PARAM_MAX_SPEED,
+    PARAM_CRUISE_KP,
+    PARAM_CRUISE_KI,
+    PARAM_CRUISE_KD,
+    PARAM_VEHICLE_PROFILE,              //VehicleProfileId
+    PARAM_SPEEDING_HYSTERESIS,          //km/h below legal_speed the average has to drop to end a speeding event
+    PARAM_SPEEDING_HOLD,                //Seconds the average has to stay over legal_speed to start one
+    PARAM_COUNT
+};
+
+struct ParamInfo {
+    const char *name;
+    float value_default;
+    float min;
+    float max;
+};
+
+/*
+################################################################################
+Parameter store
+In-RAM table of tuning parameters, indexed by ParamId so a lookup is a single
+load. Every change bumps a revision counter, which lets tasks cache values
+derived from the parameters and only rebuild them when something changed.
+The table can be saved to and loaded from the last flash sector, saving
+erases it and stops the CPU for up to FLASH_ERASE_STALL_MS, so it is only
+done on request and the stall handler is called first, like the TripLog's.
+################################################################################
+*/
+class ParameterStore {
+public:
+    ParameterStore(InternalFlash &flash);
+
+    float get(ParamId id) const { return _values[id]; }
+    bool set(ParamId id, float value);  //False if the value is outside the parameter's range
+    void restoreDefaults();
+    uint32_t revision() const { return _revision.load(std::memory_order_acquire); }
+
+    static const ParamInfo &info(ParamId id);
+    static int find(const char *name);  //ParamId for a name, -1 if unknown
+
+    bool load();                        //Reads saved values, keeps the current ones if none are valid
+    bool save();                        //False if the sector would overlap the firmware
+    void setStallHandler(void (*handler)(uint32_t stall_ms)) { _stall_handler = handler; }  //Called before the erase
+
+private:
+    InternalFlash &_flash;
+    void (*_stall_handler)(uint32_t stall_ms);
+    volatile float _values[PARAM_COUNT];
+    std::atomic<uint32_t> _revision;
+};
+
+#endif
@@ -0,0 +1,26 @@
+#include "Pedals.h"
+
+PedalChannel::PedalChannel(PinName pin) : _adc(pin), _state(0), _primed(false)
+{
+}
+
+uint16_t PedalChannel::sample(){
+    uint32_t sum(0);
+    for(int i = 0; i < (1 << PEDAL_OVERSAMPLE_SHIFT); i++){
+        sum += _adc.read_u16();
+    }
+    const int32_t value = sum >> PEDAL_OVERSAMPLE_SHIFT;    //Decimate to one value per sample
+    
+    if(!_primed){
+        _state = value << PEDAL_IIR_SHIFT;
+        _primed = true;
+    }
+    else{
+        _state += value - (_state >> PEDAL_IIR_SHIFT);      //state += x - y, output y = state / 2^n
+    }
+    
+    const int32_t filtered = _state >> PEDAL_IIR_SHIFT;
+    if(filtered <= PEDAL_DEAD_BAND) return 0;
+    if(filtered >= PEDAL_FULL - PEDAL_DEAD_BAND) return PEDAL_FULL;
+    return (uint16_t)((uint32_t)(filtered - PEDAL_DEAD_BAND) * PEDAL_FULL / (PEDAL_FULL - 2 * PEDAL_DEAD_BAND));   //Fits 32 bits unsigned
+}
@@ -0,0 +1,62 @@
+#ifndef PEDALS_H
+#define PEDALS_H
+
+#include "mbed.h"
+#include "CarModel.h"
+
+//Definitions for the pedal filter
+#ifndef PEDAL_OVERSAMPLE_SHIFT
+#define PEDAL_OVERSAMPLE_SHIFT 2        //2^n conversions averaged per sample
+#endif
+#ifndef PEDAL_IIR_SHIFT
+#define PEDAL_IIR_SHIFT 2               //Each sample moves the output 1/2^n of the way, time constant of 2^n samples
+#endif
+#define PEDAL_DEAD_BAND 1024            //Counts at either end of the travel that read as released or fully pressed
+#define PEDAL_FULL 0xFFFF
+
+//Filtered pedal positions, 0 released to PEDAL_FULL fully pressed
+struct PedalReading {
+    uint16_t accel;
+    uint16_t brakes;
+};
+
+/*
+################################################################################
+Analog pedal channel
+A potentiometer on an ADC pin. Each sample averages 2^PEDAL_OVERSAMPLE_SHIFT
+conversions back to back, which are then decimated to one value per sample
+and smoothed by a first order IIR filter in integer arithmetic (a shift and
+two adds, no multiply). The ends of the travel are cut off by
+PEDAL_DEAD_BAND so a pot that stops short of its rails still reads 0 and
+full scale. The first sample sets the filter directly so it does not ramp
+up from 0 after a reset.
+################################################################################
+*/
+class PedalChannel {
+public:
+    PedalChannel(PinName pin);
+
+    uint16_t sample();                  //Convert, filter and return the new position, thread context only
+
+private:
+    AnalogIn _adc;
+    int32_t _state;                     //Filter output scaled by 2^PEDAL_IIR_SHIFT, keeps the fraction bits
+    bool _primed;
+};
+
+//Pedal position as a fraction in the model's number type, PEDAL_FULL gives exactly 1
+inline sim_t pedalFromRaw(uint16_t raw){
+#if SIM_FIXED_POINT
+    return Fixed::fromRaw(raw + (raw >> 15));
+#else
+    return raw * (1.0f / PEDAL_FULL);
+#endif
+}
+
+//Replaces the on/off accelerator and brakes from the switches with the pedal positions
+inline void applyPedals(DriverInputs &inputs, const PedalReading &pedals){
+    inputs.accel = pedalFromRaw(pedals.accel);
+    inputs.brakes = pedalFromRaw(pedals.brakes);
+}
+
+#endif
@@ -0,0 +1,99 @@
+#include "PeriodicTask.h"
+#include "CycleCounter.h"
+
+PeriodicTask *PeriodicTask::_tasks[MAX_PERIODIC_TASKS];
+size_t PeriodicTask::_count(0);
+
+PeriodicTask::PeriodicTask(const ThreadConfig &config, void (*step)())
+    : _name(config.name), _step(step), _period_ms(config.period_ms), _parked(false), _shed(false), _heartbeat_ms(0), _config(config),
+      _thread(config.priority, config.stack_size, config.stack, config.name)
+{
+    resetStats();
+    MBED_ASSERT(_count < MAX_PERIODIC_TASKS);
+    if(_count < MAX_PERIODIC_TASKS){                    //Register task so it can be queried at runtime
+        _tasks[_count++] = this;
+    }
+}
+
+void PeriodicTask::start(){
+    _heartbeat_ms = (uint32_t)Kernel::get_ms_count();
+    prepareStack(_config);
+    _thread.start(callback(this, &PeriodicTask::run));
+}
+
+void PeriodicTask::park(){
+    _parked = true;                                     //Seen by the task after its current sleep
+}
+
+void PeriodicTask::resume(){
+    _heartbeat_ms = (uint32_t)Kernel::get_ms_count();             //Not late just because it was parked
+    _parked = false;
+    _thread.flags_set(PERIODIC_RESUME_FLAG);
+}
+
+void PeriodicTask::setPeriod(uint32_t period_ms){
+    if(period_ms > 0) _period_ms = period_ms;
+}
+
+TaskStats PeriodicTask::stats() const {
+    core_util_critical_section_enter();                 //Task may be updating the counters
+    const TaskStats copy = _stats;
+    core_util_critical_section_exit();
+    return copy;
+}
+
+void PeriodicTask::resetStats(){
+    core_util_critical_section_enter();
+    memset(&_stats, 0, sizeof(_stats));
+    _stats.exec_min_us = UINT32_MAX;
+    core_util_critical_section_exit();
+}
+
+size_t PeriodicTask::count(){
+    return _count;
+}
+
+PeriodicTask *PeriodicTask::get(size_t index){
+    return index < _count ? _tasks[index] : NULL;
+}
+
+void PeriodicTask::run(){
+    uint64_t deadline = Kernel::get_ms_count();         //First release is immediate
+    while(true){
+        if(_parked){
+            while(_parked){                             //Block until resumed, no wakeups while parked
+                ThisThread::flags_wait_any(PERIODIC_RESUME_FLAG);
+            }
+            deadline = Kernel::get_ms_count();          //Restart deadlines from now
+        }
+
+        const bool shed = _shed;
+        const uint32_t started = CycleCounter::now();
+        if(!shed) _step();
+        const uint32_t exec_us = CycleCounter::toUs(CycleCounter::now() - started);
+
+        const uint32_t period_ms = _period_ms;
+        deadline += period_ms;                          //Next absolute release time
+        const uint64_t now = Kernel::get_ms_count();
+        const bool late = now > deadline;
+        _heartbeat_ms = (uint32_t)now;
+
+        core_util_critical_section_enter();             //Update statistics
+        if(shed){
+            _stats.skipped++;
+        }
+        else{
+            _stats.releases++;
+            _stats.exec_total_us += exec_us;
+            if(exec_us < _stats.exec_min_us) _stats.exec_min_us = exec_us;
+            if(exec_us > _stats.exec_max_us) _stats.exec_max_us = exec_us;
+        }
+        if(late) _stats.overruns++;
+        core_util_critical_section_exit();
+
+        if(late){                                       //Finished late, skip missed releases
+            deadline += ((now - deadline) / period_ms + 1) * period_ms;
+        }
+        ThisThread::sleep_until(deadline);
+    }
+}
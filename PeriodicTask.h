@@ -0,0 +1,91 @@
+#ifndef PERIODIC_TASK_H
+#define PERIODIC_TASK_H
+
+#include "mbed.h"
+#include "ThreadConfig.h"
+
+#define MAX_PERIODIC_TASKS 8            //Maximum number of tasks the scheduler can hold
+#define PERIODIC_RESUME_FLAG 0x80000000u    //Thread flag used to wake a parked task
+
+/*
+################################################################################
+Timing statistics for one task, all times are in microseconds.
+Execution time is measured from release to the end of the step, so it includes
+time spent preempted by higher priority tasks.
+################################################################################
+*/
+struct TaskStats {
+    uint32_t releases;                  //Number of times the step has run
+    uint32_t overruns;                  //Number of deadlines missed
+    uint32_t skipped;                   //Releases where the step was not run because the task was shed
+    uint32_t exec_min_us;
+    uint32_t exec_max_us;
+    uint64_t exec_total_us;
+
+    uint32_t execMeanUs() const { return releases ? exec_total_us / releases : 0; }
+};
+
+/*
+################################################################################
+Periodic task
+Runs a step function on its own thread at a fixed rate. Wakeups are scheduled
+against absolute deadlines (start + n * period) so execution time does not
+make the period drift. A step that finishes after its next deadline is
+counted as an overrun, and the missed releases are skipped while keeping the
+original phase.
+Every step is timed with the cycle counter, the statistics can be read or
+reset from any thread.
+A task can be parked, it then blocks without any timeouts after its current
+step until it is resumed, and restarts its deadlines from the time it resumes.
+The period can be changed at runtime and applies from the next release.
+A task can also be shed under overload, it then keeps releasing on time
+but skips its step. Every release updates a heartbeat timestamp, which the
+Supervisor compares with the period to detect a starved task.
+The thread's priority, static stack and initial period come from its
+ThreadConfig.
+################################################################################
+*/
+class PeriodicTask {
+public:
+    PeriodicTask(const ThreadConfig &config, void (*step)());
+
+    void start();                       //Start the task's thread
+    void park();                        //Stop running the step until resume() is called
+    void resume();
+    void setPeriod(uint32_t period_ms);
+    void setShed(bool shed) { _shed = shed; }   //Skip the step from the next release while set
+
+    const char *name() const { return _name; }
+    uint32_t period_ms() const { return _period_ms; }
+    bool parked() const { return _parked; }
+    bool shed() const { return _shed; }
+    uint32_t heartbeatMs() const { return _heartbeat_ms; }  //Low 32 bits of the kernel ms count at the last release
+    uint32_t overruns() const { return _stats.overruns; }
+    uint32_t releases() const { return _stats.releases; }
+    const Thread &thread() const { return _thread; }
+    const ThreadConfig &config() const { return _config; }
+
+    TaskStats stats() const;            //Consistent copy of the statistics
+    void resetStats();
+
+    static size_t count();              //Number of registered tasks
+    static PeriodicTask *get(size_t index);
+
+private:
+    void run();
+
+    const char *_name;
+    void (*_step)();
+    volatile uint32_t _period_ms;
+    volatile bool _parked;
+    volatile bool _shed;
+    volatile uint32_t _heartbeat_ms;
+    TaskStats _stats;
+    const ThreadConfig &_config;
+    Thread _thread;
+
+    static PeriodicTask *_tasks[MAX_PERIODIC_TASKS];
+    static size_t _count;
+};
+
+#endif
@@ -0,0 +1,86 @@
+#ifndef PID_CONTROLLER_H
+#define PID_CONTROLLER_H
+
+/*
+################################################################################
+PID controller
+Works with any number type that supports the usual arithmetic, including
+Fixed. Gains are given per second and folded with the control period once in
+the constructor, so update() is a handful of multiply-adds.
+- Derivative acts on the measurement, so setpoint changes do not kick the
+  output, and is low-pass filtered with time constant derivative_tau.
+- Integral is clamped to the output range and stops integrating while the
+  output is saturated in the direction of the error (anti-windup).
+- Output is saturated to [output_min, output_max].
+################################################################################
+*/
+template <typename T>
+class PidController {
+public:
+    PidController(T kp, T ki, T kd, T period_s, T derivative_tau, T output_min, T output_max)
+        : _period_s(period_s), _derivative_alpha(period_s / (derivative_tau + period_s)),
+          _output_min(output_min), _output_max(output_max)
+    {
+        setGains(kp, ki, kd);
+        reset();
+    }
+
+    //Changes the gains, keeps the integral so the output does not jump
+    void setGains(T kp, T ki, T kd){
+        _kp = kp;
+        _ki_dt = ki * _period_s;
+        _kd_dt = kd / _period_s;
+    }
+
+    //Clears integral and derivative history, integral starts from initial
+    void reset(T initial = T(0)){
+        _integral = clamp(initial);
+        _derivative = T(0);
+        _primed = false;
+    }
+
+    //Runs one control period, feed_forward is added to the output before saturation
+    T update(T setpoint, T measurement, T feed_forward = T(0)){
+        const T error = setpoint - measurement;
+
+        if(_primed){                                    //Derivative of the measurement, low-pass filtered
+            const T raw = (_last_measurement - measurement) * _kd_dt;
+            _derivative += _derivative_alpha * (raw - _derivative);
+        }
+        _last_measurement = measurement;
+        _primed = true;
+
+        const T integral = clamp(_integral + _ki_dt * error);
+        const T unsaturated = _kp * error + integral + _derivative + feed_forward;
+        const T output = clamp(unsaturated);
+        const bool winding_up = (unsaturated > _output_max && error > T(0)) || (unsaturated < _output_min && error < T(0));
+        if(!winding_up){                                //Only integrate while it does not push further into saturation
+            _integral = integral;
+        }
+        return output;
+    }
+
+    T integral() const { return _integral; }
+
+private:
+    T clamp(T value) const {
+        if(value < _output_min) return _output_min;
+        if(value > _output_max) return _output_max;
+        return value;
+    }
+
+    T _period_s;
+    T _kp;
+    T _ki_dt;                           //Integral gain * period
+    T _kd_dt;                           //Derivative gain / period
+    T _derivative_alpha;                //First-order filter coefficient for the derivative
+    T _output_min;
+    T _output_max;
+
+    T _integral;
+    T _derivative;
+    T _last_measurement;
+    bool _primed;                       //A previous measurement is available
+};
+
+#endif
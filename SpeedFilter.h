@@ -0,0 +1,101 @@
+#ifndef SPEED_FILTER_H
+#define SPEED_FILTER_H
+
+#include <stddef.h>
+#include "FixedPoint.h"
+
+//Running sum of a moving average, wide enough for a whole window of samples
+template <typename T>
+struct AverageSum {
+    typedef T type;
+    static T mean(const T &sum, size_t count) { return sum / T((int)count); }
+};
+
+//A Q16.16 sum overflows past 32767, e.g. 125 samples at 280 km/h
+template <>
+struct AverageSum<Fixed> {
+    typedef FixedAccumulator type;
+    static Fixed mean(const FixedAccumulator &sum, size_t count) { return Fixed::fromRaw((int32_t)(sum.raw() / (int64_t)count)); }
+};
+
+/*
+################################################################################
+Moving average filter
+Keeps the last Window samples and a running sum, so each update is O(1) no
+matter how long the window is. The sum is rebuilt from the stored samples
+once per lap of the window to stop rounding error from accumulating, which
+keeps the amortised cost constant. The sum is kept in AverageSum<T>::type,
+which is a 64-bit accumulator for Fixed samples.
+################################################################################
+*/
+template <typename T, size_t Window>
+class MovingAverage {
+    static_assert(Window > 0, "MovingAverage window must hold at least one sample");
+
+    typedef typename AverageSum<T>::type Sum;
+
+public:
+    MovingAverage() : _sum(), _index(0), _count(0) {}
+
+    T update(T sample){
+        if(_count == Window){
+            _sum -= _samples[_index];                   //Drop the oldest sample from the sum
+        }
+        else{
+            _count++;
+        }
+        _samples[_index] = sample;
+        _sum += sample;
+
+        if(++_index == Window){                         //Completed a lap of the window, rebuild the sum
+            _index = 0;
+            Sum sum = Sum();
+            for(size_t i = 0; i < Window; i++) sum += _samples[i];
+            _sum = sum;
+        }
+        return value();
+    }
+
+    T value() const { return _count ? AverageSum<T>::mean(_sum, _count) : T(0); }
+    size_t count() const { return _count; }
+
+private:
+    T _samples[Window];
+    Sum _sum;
+    size_t _index;                      //Slot the next sample is written to
+    size_t _count;                      //Number of valid samples, saturates at Window
+};
+
+/*
+################################################################################
+Exponential moving average filter
+value += alpha * (sample - value). Needs no sample storage, an alpha of
+2 / (N + 1) gives roughly the same smoothing as an N sample moving average.
+################################################################################
+*/
+template <typename T>
+class ExponentialAverage {
+public:
+    explicit ExponentialAverage(T alpha) : _alpha(alpha), _value(0), _count(0) {}
+
+    T update(T sample){
+        if(_count == 0){
+            _value = sample;                            //Seed with the first sample instead of ramping up from 0
+            _count = 1;
+        }
+        else{
+            _value += _alpha * (sample - _value);
+        }
+        return _value;
+    }
+
+    T value() const { return _value; }
+    size_t count() const { return _count; }
+
+private:
+    T _alpha;
+    T _value;
+    size_t _count;
+};
+
+#endif
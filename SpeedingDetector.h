@@ -0,0 +1,82 @@
+#ifndef SPEEDING_DETECTOR_H
+#define SPEEDING_DETECTOR_H
+
+#include "VehicleState.h"
+#include <stdint.h>
+
+enum SpeedingEventType {
+    SPEEDING_ENTER = 1,
+    SPEEDING_EXIT = 2
+};
+
+struct SpeedingEvent {
+    uint32_t time_ms;                   //When the event was detected
+    uint32_t start_ms;                  //When the average speed first went over the limit
+    sim_t peak;                         //Highest average speed since start_ms
+    uint8_t type;                       //SpeedingEventType
+};
+
+/*
+################################################################################
+Speeding event detector
+Turns the average speed into speeding events. The average has to stay above
+the limit for hold_ms before an enter event is emitted, and has to drop below
+limit - hysteresis before the exit event, so an average hovering at the limit
+neither chatters nor counts as many short events. Both events carry the time
+the average first went over the limit and the peak so far. update() only
+returns true on an event, so whatever it drives is written on edges only.
+No hardware access, so it runs the same on the host.
+################################################################################
+*/
+class SpeedingDetector {
+public:
+    SpeedingDetector() : _state(CLEAR), _start_ms(0), _peak(0), _events(0) {}
+
+    bool update(sim_t average, sim_t limit, sim_t hysteresis, uint32_t hold_ms, uint32_t time_ms, SpeedingEvent &event){
+        switch(_state){
+        case CLEAR:
+            if(!(average > limit)) return false;
+            _state = PENDING;                           //Over the limit, not yet for long enough
+            _start_ms = time_ms;
+            _peak = average;                            //A hold time of 0 enters straight away
+            //Fall through
+        case PENDING:
+            if(!(average > limit)){
+                _state = CLEAR;                         //Too short to count
+                return false;
+            }
+            if(average > _peak) _peak = average;
+            if(time_ms - _start_ms < hold_ms) return false;
+            _state = SPEEDING;
+            _events++;
+            return makeEvent(SPEEDING_ENTER, time_ms, event);
+        case SPEEDING:
+            if(average > _peak) _peak = average;
+            if(!(average < limit - hysteresis)) return false;
+            _state = CLEAR;
+            return makeEvent(SPEEDING_EXIT, time_ms, event);
+        }
+        return false;
+    }
+
+    bool speeding() const { return _state == SPEEDING; }
+    uint32_t events() const { return _events; }     //Enter events so far
+
+private:
+    enum State { CLEAR, PENDING, SPEEDING };
+
+    bool makeEvent(SpeedingEventType type, uint32_t time_ms, SpeedingEvent &event) const {
+        event.time_ms = time_ms;
+        event.start_ms = _start_ms;
+        event.peak = _peak;
+        event.type = type;
+        return true;
+    }
+
+    State _state;
+    uint32_t _start_ms;
+    sim_t _peak;
+    uint32_t _events;
+};
+
+#endif
@@ -0,0 +1,63 @@
+#ifndef SPSC_RING_H
+#define SPSC_RING_H
+
+#include <atomic>
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+################################################################################
+Single-producer/single-consumer ring buffer
+Fixed-capacity, statically allocated history of the latest samples. The
+producer pushes without waiting and overwrites the oldest sample once the
+buffer is full. The consumer drains everything pushed since its last read,
+and retries if the producer overwrote any of them during the copy, so
+neither side takes a lock.
+Capacity must be a power of two, one slot is kept free for the sample being
+written, so at most Capacity-1 samples can be read back.
+################################################################################
+*/
+template <typename T, size_t Capacity>
+class SpscRing {
+    static_assert(Capacity >= 2 && (Capacity & (Capacity - 1)) == 0, "SpscRing capacity must be a power of two");
+
+public:
+    SpscRing() : _head(0) {}
+
+    //Producer side, wait-free
+    void push(const T &value){
+        const uint32_t head = _head.load(std::memory_order_relaxed);
+        _buffer[head & (Capacity - 1)] = value;
+        _head.store(head + 1, std::memory_order_release);          //Publish sample after it is written
+    }
+
+    //Consumer side, copies up to max samples pushed after cursor (oldest first) and
+    //advances cursor. Samples that were already overwritten are skipped.
+    size_t readFrom(uint32_t &cursor, T *out, size_t max) const {
+        while(true){
+            const uint32_t head = _head.load(std::memory_order_acquire);
+            uint32_t from = cursor;
+            if(head - from > Capacity - 1) from = head - (Capacity - 1);   //Fell behind, start at oldest readable sample
+            size_t n = head - from;
+            if(n > max) n = max;
+            for(size_t i = 0; i < n; i++){
+                out[i] = _buffer[(from + i) & (Capacity - 1)];
+            }
+            std::atomic_thread_fence(std::memory_order_acquire);
+            const uint32_t pushed = _head.load(std::memory_order_relaxed) - head;
+            if(pushed + (head - from) < Capacity){                  //None of the copied slots were reused
+                cursor = from + n;
+                return n;
+            }
+        }
+    }
+
+    //Total number of samples pushed since start
+    uint32_t pushed() const { return _head.load(std::memory_order_acquire); }
+
+private:
+    T _buffer[Capacity];
+    std::atomic<uint32_t> _head;        //Free-running write index, only written by the producer
+};
+
+#endif
@@ -0,0 +1,44 @@
+#include "StageLatency.h"
+#include "CycleCounter.h"
+
+StageLatency *StageLatency::_edges[MAX_STAGE_LATENCIES];
+size_t StageLatency::_count(0);
+
+StageLatency::StageLatency(const char *name) : _name(name)
+{
+    reset();
+    MBED_ASSERT(_count < MAX_STAGE_LATENCIES);
+    if(_count < MAX_STAGE_LATENCIES){                   //Register edge so it can be queried at runtime
+        _edges[_count++] = this;
+    }
+}
+
+void StageLatency::record(uint32_t stamp){
+    const uint32_t latency_us = CycleCounter::toUs(CycleCounter::now() - stamp);
+    core_util_critical_section_enter();                 //Keep the counters consistent for stats()
+    _stats.messages++;
+    _stats.latency_total_us += latency_us;
+    if(latency_us > _stats.latency_max_us) _stats.latency_max_us = latency_us;
+    core_util_critical_section_exit();
+}
+
+LatencyStats StageLatency::stats() const {
+    core_util_critical_section_enter();
+    const LatencyStats copy = _stats;
+    core_util_critical_section_exit();
+    return copy;
+}
+
+void StageLatency::reset(){
+    core_util_critical_section_enter();
+    memset(&_stats, 0, sizeof(_stats));
+    core_util_critical_section_exit();
+}
+
+size_t StageLatency::count(){
+    return _count;
+}
+
+StageLatency *StageLatency::get(size_t index){
+    return index < _count ? _edges[index] : NULL;
+}
@@ -0,0 +1,46 @@
+#ifndef STAGE_LATENCY_H
+#define STAGE_LATENCY_H
+
+#include "mbed.h"
+
+#define MAX_STAGE_LATENCIES 8
+
+struct LatencyStats {
+    uint32_t messages;                  //Messages received
+    uint32_t latency_max_us;
+    uint64_t latency_total_us;
+
+    uint32_t meanUs() const { return messages ? (uint32_t)(latency_total_us / messages) : 0; }
+};
+
+/*
+################################################################################
+Stage latency
+Age of the messages a stage receives on one edge of the task pipeline, from
+the moment the producer posted them to the moment the consumer picked them
+up. Updated only by the consumer, the registry lets the console list every
+edge by name.
+################################################################################
+*/
+class StageLatency {
+public:
+    StageLatency(const char *name);
+
+    void record(uint32_t stamp);        //Cycle counter value the message was posted at
+    LatencyStats stats() const;         //Consistent copy, safe from any thread
+    void reset();
+
+    const char *name() const { return _name; }
+
+    static size_t count();              //Number of registered edges
+    static StageLatency *get(size_t index);
+
+private:
+    const char *_name;
+    LatencyStats _stats;
+
+    static StageLatency *_edges[MAX_STAGE_LATENCIES];
+    static size_t _count;
+};
+
+#endif
@@ -0,0 +1,35 @@
+#ifndef STATIC_OBJECT_H
+#define STATIC_OBJECT_H
+
+#include "mbed.h"
+#include <new>
+#include <utility>
+
+/*
+################################################################################
+Static object
+Statically allocated storage for one object that has to be constructed at a
+particular point in main() rather than during static initialisation, such as
+a driver that talks to hardware in its constructor. construct() builds the
+object in place, so it takes no heap and its size shows up in the linker
+map. The object is never destroyed.
+################################################################################
+*/
+template<typename T>
+class StaticObject {
+public:
+    StaticObject() : _constructed(false) {}
+
+    template<typename... Args>
+    T *construct(Args&&... args){
+        MBED_ASSERT(!_constructed);
+        _constructed = true;
+        return new (_storage) T(std::forward<Args>(args)...);
+    }
+
+private:
+    alignas(T) unsigned char _storage[sizeof(T)];
+    bool _constructed;
+};
+
+#endif
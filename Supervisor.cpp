@@ -0,0 +1,95 @@
+#include "Supervisor.h"
+
+Supervisor::Supervisor(const ThreadConfig &config, uint32_t watchdog_ms, uint32_t idle_ms)
+    : _config(config), _thread(config.priority, config.stack_size, config.stack, config.name),
+      _critical_count(0), _sheddable_count(0), _check_ms(config.period_ms), _watchdog_ms(watchdog_ms), _idle_ms(idle_ms), _idle(false),
+      _shedding(false), _watchdog_running(false), _overloads(0), _late_checks(0), _stalls(0), _stall_until(0), _stalled(false)
+{
+}
+
+bool Supervisor::watch(PeriodicTask &task){
+    if(_critical_count >= MAX_SUPERVISED_TASKS) return false;
+    _overruns_seen[_critical_count] = task.overruns();
+    _critical[_critical_count++] = &task;
+    return true;
+}
+
+bool Supervisor::shedUnderLoad(PeriodicTask &task){
+    if(_sheddable_count >= MAX_SUPERVISED_TASKS) return false;
+    _sheddable[_sheddable_count++] = &task;
+    return true;
+}
+
+void Supervisor::start(){
+    prepareStack(_config);
+    _thread.start(callback(this, &Supervisor::run));
+}
+
+void Supervisor::setIdle(bool idle){
+    _idle = idle;
+    _thread.flags_set(SUPERVISOR_WAKE_FLAG);           //Switch now instead of at the end of a long idle wait
+}
+
+void Supervisor::expectStall(uint32_t stall_ms){
+    _stall_until = (uint32_t)Kernel::get_ms_count() + stall_ms + 2 * _check_ms;  //The tasks only count the overruns once they run again
+    _stalled = true;
+    _stalls++;
+}
+
+void Supervisor::setShed(bool shed){
+    for(size_t i = 0; i < _sheddable_count; i++){
+        _sheddable[i]->setShed(shed);
+    }
+    _shedding = shed;
+}
+
+void Supervisor::run(){
+#if DEVICE_WATCHDOG
+    _watchdog_running = Watchdog::get_instance().start(_watchdog_ms);
+#endif
+    uint64_t next = Kernel::get_ms_count();
+    uint32_t calm_since = (uint32_t)next;               //Last check that found an overload
+    while(true){
+        const uint32_t now = (uint32_t)Kernel::get_ms_count();
+        bool late = false;
+        bool overrun = false;
+        for(size_t i = 0; i < _critical_count; i++){
+            PeriodicTask *task = _critical[i];
+            const uint32_t overruns = task->overruns();
+            if(overruns != _overruns_seen[i]) overrun = true;
+            _overruns_seen[i] = overruns;
+            if(!task->parked() && now - task->heartbeatMs() > task->period_ms() * SUPERVISOR_LATE_PERIODS){
+                late = true;
+            }
+        }
+        if(_stalled){                                   //Late for a known reason, the overruns are still counted by the tasks
+            if((int32_t)(_stall_until - now) > 0) late = overrun = false;
+            else _stalled = false;
+        }
+        
+        if(late || overrun){                            //Shed at once, recover only after a calm spell
+            calm_since = now;
+            if(!_shedding){
+                setShed(true);
+                _overloads++;
+            }
+        }
+        else if(_shedding && now - calm_since >= SUPERVISOR_RECOVER_MS){
+            setShed(false);
+        }
+        
+        if(late){
+            _late_checks++;                             //Let the watchdog run out if it stays that way
+        }
+#if DEVICE_WATCHDOG
+        else if(_watchdog_running){
+            Watchdog::get_instance().kick();
+        }
+#endif
+        next += _idle ? _idle_ms : _check_ms;
+        if(ThisThread::flags_wait_any_until(SUPERVISOR_WAKE_FLAG, next) & SUPERVISOR_WAKE_FLAG){
+            next = Kernel::get_ms_count() + _check_ms;  //Give resumed tasks a whole check period to release
+            ThisThread::sleep_until(next);
+        }
+    }
+}
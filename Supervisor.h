@@ -0,0 +1,77 @@
+#ifndef SUPERVISOR_H
+#define SUPERVISOR_H
+
+#include "mbed.h"
+#include "PeriodicTask.h"
+#include "ThreadConfig.h"
+
+#define MAX_SUPERVISED_TASKS 8
+#define SUPERVISOR_LATE_PERIODS 3       //A critical task is late after this many periods without a release
+#define SUPERVISOR_RECOVER_MS 2000      //Time without overload before shed tasks run again
+#define SUPERVISOR_WAKE_FLAG 0x1        //Thread flag set by setIdle()
+
+/*
+################################################################################
+Supervisor
+Checks the critical tasks every period of its ThreadConfig from a thread
+above all of them.
+A critical task is late when its heartbeat is older than
+SUPERVISOR_LATE_PERIODS of its period, parked tasks are not checked. The
+hardware watchdog is only kicked while no critical task is late, so a
+starved sim or cruise task resets the board after watchdog_ms.
+A late critical task, or a new overrun of one, counts as overload: the
+sheddable tasks are shed (they skip their steps) until the critical tasks
+have kept their deadlines for SUPERVISOR_RECOVER_MS, which trades the
+display and averaging for bounded latency on the control path.
+While the control tasks are parked for low power the checks run every
+idle_ms instead, so the supervisor rarely wakes the CPU from sleep.
+The LPC1768 watchdog cannot be stopped once started, so watchdog_ms has to
+be longer than idle_ms.
+A known stall, such as a flash erase that stops the CPU, is announced with
+expectStall(). Late tasks and overruns are then neither overload nor a
+reason to stop the kicks until the stall and two more checks are over.
+################################################################################
+*/
+class Supervisor {
+public:
+    Supervisor(const ThreadConfig &config, uint32_t watchdog_ms, uint32_t idle_ms);
+
+    bool watch(PeriodicTask &task);     //Register a critical task, before start()
+    bool shedUnderLoad(PeriodicTask &task);     //Register a task that may be shed, before start()
+    void start();
+    void setIdle(bool idle);            //Check every idle_ms instead of every period, e.g. while the control tasks are parked
+    void expectStall(uint32_t stall_ms);    //Call just before something stops every task for up to stall_ms
+
+    bool shedding() const { return _shedding; }
+    bool watchdogRunning() const { return _watchdog_running; }
+    bool idle() const { return _idle; }
+    uint32_t overloads() const { return _overloads; }       //Times shedding started
+    uint32_t lateChecks() const { return _late_checks; }    //Checks that found a critical task late and did not kick
+    uint32_t stalls() const { return _stalls; }             //Stalls announced with expectStall()
+    const Thread &thread() const { return _thread; }
+
+private:
+    void run();
+    void setShed(bool shed);
+
+    const ThreadConfig &_config;
+    Thread _thread;
+    PeriodicTask *_critical[MAX_SUPERVISED_TASKS];
+    uint32_t _overruns_seen[MAX_SUPERVISED_TASKS];
+    size_t _critical_count;
+    PeriodicTask *_sheddable[MAX_SUPERVISED_TASKS];
+    size_t _sheddable_count;
+    uint32_t _check_ms;
+    uint32_t _watchdog_ms;
+    uint32_t _idle_ms;
+    volatile bool _idle;
+    volatile bool _shedding;
+    volatile bool _watchdog_running;
+    volatile uint32_t _overloads;
+    volatile uint32_t _late_checks;
+    volatile uint32_t _stalls;
+    volatile uint32_t _stall_until;     //Low 32 bits of the kernel ms count the announced stall is tolerated until
+    volatile bool _stalled;
+};
+
+#endif
@@ -0,0 +1,30 @@
+#ifndef SWITCHES_H
+#define SWITCHES_H
+
+#include "CarModel.h"
+#include <stdint.h>
+
+//Definitions for switch ports
+#define ENGINE_SWITCH 8                 //Switch 1
+#define ACCEL_SWITCH 9                  //Switch 2
+#define BRAKES_SWITCH 10                //Switch 3
+#define CC_SWITCH 11                    //Switch 4    
+#define SWITCH_ON(snapshot, bit) (((snapshot) >> (bit)) & 1)   //Decode a single switch from a port snapshot
+#define SWITCH_MASK ((1 << ENGINE_SWITCH) | (1 << ACCEL_SWITCH) | (1 << BRAKES_SWITCH) | (1 << CC_SWITCH))
+
+/*
+################################################################################
+Decodes the driver controls from a port snapshot. Shared by the firmware and
+the host replay, so a recorded trace drives the model exactly like the port.
+################################################################################
+*/
+inline DriverInputs decodeInputs(uint16_t snapshot){
+    DriverInputs inputs;
+    inputs.ignition = SWITCH_ON(snapshot, ENGINE_SWITCH);
+    inputs.cruise_switch = SWITCH_ON(snapshot, CC_SWITCH);
+    inputs.accel = SWITCH_ON(snapshot, ACCEL_SWITCH);
+    inputs.brakes = SWITCH_ON(snapshot, BRAKES_SWITCH);
+    return inputs;
+}
+
+#endif
@@ -0,0 +1,19 @@
+#ifndef TASK_RATES_H
+#define TASK_RATES_H
+
+/*
+################################################################################
+Task periods
+The only place the task rates are written down. The thread table in
+main.cpp takes its periods from here, and so do the host benchmarks and
+replay, which step the model on the same grid as the firmware.
+################################################################################
+*/
+#define INPUT_PERIOD_MS 40              //25 Hz
+#define AVERAGE_PERIOD_MS 200           //5 Hz
+#define DISPLAY_PERIOD_MS 500           //2 Hz
+#define CRUISE_PERIOD_MS 50             //20 Hz
+#define SIM_PERIOD_MS 40                //25 Hz
+#define PEDAL_PERIOD_MS 10              //100 Hz, several filtered samples per sim step
+
+#endif
@@ -0,0 +1,105 @@
+#include "Telemetry.h"
+#include "Crc.h"
+
+#define TELEMETRY_READY_FLAG 0x1        //Thread flag set when a sample is queued
+#define TELEMETRY_BATCH 4               //Samples encoded per wakeup
+
+static uint8_t *putU16(uint8_t *out, uint16_t value){
+    out[0] = value;
+    out[1] = value >> 8;
+    return out + 2;
+}
+
+static uint8_t *putU32(uint8_t *out, uint32_t value){
+    out[0] = value;
+    out[1] = value >> 8;
+    out[2] = value >> 16;
+    out[3] = value >> 24;
+    return out + 4;
+}
+
+//Scales to an unsigned field, clamped at both ends
+static uint32_t toField(int32_t scaled, uint32_t max){
+    if(scaled < 0) return 0;
+    return (uint32_t)scaled > max ? max : (uint32_t)scaled;
+}
+
+//Frame header and CRC around a payload already written at out + 4
+static size_t finishFrame(uint8_t *out, uint8_t type, uint8_t *end){
+    out[0] = TELEMETRY_SYNC_0;
+    out[1] = TELEMETRY_SYNC_1;
+    out[2] = end - (out + 4);
+    out[3] = type;
+    end = putU16(end, crc16(out + 2, end - (out + 2)));  //CRC covers length, type and payload
+    return end - out;
+}
+
+size_t encodeTelemetryFrame(const TelemetrySample &sample, uint8_t *out){
+    const VehicleState &state = sample.state;
+    uint8_t *p = out + 4;
+    p = putU32(p, sample.time_ms);
+    p = putU32(p, state.step);
+    p = putU16(p, toField(toScaled(state.speed, 100), 0xFFFF));
+    p = putU16(p, toField(toScaled(state.accel, 1000), 0xFFFF));
+    p = putU16(p, toField(toScaled(state.brakes, 1000), 0xFFFF));
+    p = putU32(p, toField(toScaled(state.odometry, 10), INT32_MAX));
+    *p++ = (state.ignition ? TELEMETRY_FLAG_IGNITION : 0) | (state.cruise_mode ? TELEMETRY_FLAG_CRUISE : 0);
+    return finishFrame(out, TELEMETRY_TYPE_STATE, p);
+}
+
+size_t encodeSpeedingFrame(const SpeedingEvent &event, uint8_t *out){
+    uint8_t *p = out + 4;
+    *p++ = event.type;
+    p = putU32(p, event.time_ms);
+    p = putU32(p, event.start_ms);
+    p = putU16(p, toField(toScaled(event.peak, 100), 0xFFFF));
+    return finishFrame(out, TELEMETRY_TYPE_SPEEDING, p);
+}
+
+Telemetry::Telemetry(PinName tx, PinName rx, int baud, const ThreadConfig &config)
+    : _serial(tx, rx, baud), _config(config), _thread(config.priority, config.stack_size, config.stack, config.name), _cursor(0), _event_cursor(0), _sent(0), _dropped(0)
+{
+}
+
+void Telemetry::start(){
+    prepareStack(_config);
+    _thread.start(callback(this, &Telemetry::run));
+}
+
+void Telemetry::publish(const VehicleState &state, uint32_t time_ms){
+    TelemetrySample sample;
+    sample.state = state;
+    sample.time_ms = time_ms;
+    _queue.push(sample);
+    _thread.flags_set(TELEMETRY_READY_FLAG);
+}
+
+void Telemetry::publishEvent(const SpeedingEvent &event){
+    _events.push(event);
+    _thread.flags_set(TELEMETRY_READY_FLAG);
+}
+
+void Telemetry::run(){
+    TelemetrySample samples[TELEMETRY_BATCH];
+    uint8_t frame[TELEMETRY_MAX_FRAME];
+    while(true){
+        ThisThread::flags_wait_any(TELEMETRY_READY_FLAG);
+        SpeedingEvent event;
+        while(_events.readFrom(_event_cursor, &event, 1) == 1){    //Rare, sent first
+            _serial.write(frame, encodeSpeedingFrame(event, frame));
+            _sent++;
+        }
+        while(true){
+            const uint32_t expected = _queue.pushed() - _cursor;    //Anything beyond what readFrom returns was overwritten
+            const size_t count = _queue.readFrom(_cursor, samples, TELEMETRY_BATCH);
+            if(count == 0) break;
+            if(expected > TELEMETRY_QUEUE_SIZE - 1) _dropped += expected - (TELEMETRY_QUEUE_SIZE - 1);
+            
+            for(size_t i = 0; i < count; i++){
+                const size_t length = encodeTelemetryFrame(samples[i], frame);
+                _serial.write(frame, length);                       //Buffered, sent from the UART interrupt
+                _sent++;
+            }
+        }
+    }
+}
@@ -0,0 +1,85 @@
+#ifndef TELEMETRY_H
+#define TELEMETRY_H
+
+#include "mbed.h"
+#include "SpscRing.h"
+#include "ThreadConfig.h"
+#include "VehicleState.h"
+#include "SpeedingDetector.h"
+
+#define TELEMETRY_QUEUE_SIZE 16         //Frames buffered between the sim and the UART, power of two
+#define TELEMETRY_EVENT_QUEUE_SIZE 4    //Speeding events buffered between the averaging task and the UART, power of two
+#define TELEMETRY_SYNC_0 0xA5
+#define TELEMETRY_SYNC_1 0x5A
+#define TELEMETRY_TYPE_STATE 0x01
+#define TELEMETRY_TYPE_SPEEDING 0x02
+#define TELEMETRY_STATE_PAYLOAD 19
+#define TELEMETRY_SPEEDING_PAYLOAD 11
+#define TELEMETRY_FRAME_OVERHEAD 6      //Sync, length, type and CRC
+#define TELEMETRY_MAX_FRAME (TELEMETRY_FRAME_OVERHEAD + TELEMETRY_STATE_PAYLOAD)
+
+#define TELEMETRY_FLAG_IGNITION 0x01
+#define TELEMETRY_FLAG_CRUISE 0x02
+
+/*
+################################################################################
+Binary telemetry
+Frame layout, multi-byte fields little endian:
+  0     0xA5 0x5A sync
+  2     payload length
+  3     frame type, 0x01 = vehicle state, 0x02 = speeding event
+  4     payload
+  4+n   CRC-16/CCITT-FALSE of length, type and payload
+Vehicle state payload (19 bytes):
+  u32 time in ms, u32 sim step, u16 speed in 0.01 km/h,
+  u16 accelerator and u16 brakes in 0.001 of full pedal,
+  u32 odometry in 0.1 units, u8 flags (bit 0 ignition, bit 1 cruise)
+Speeding event payload (11 bytes):
+  u8 event (1 enter, 2 exit), u32 time in ms, u32 time the average speed
+  went over the limit in ms, u16 peak average speed in 0.01 km/h
+The sim only copies its state into a lock-free queue, a low priority thread
+encodes the frames and hands them to the interrupt driven serial driver, so
+the sim never waits on the UART. If the UART falls behind, the oldest frames
+are dropped and counted. Speeding events come from the averaging task on a
+queue of their own and are sent ahead of any queued states.
+################################################################################
+*/
+
+struct TelemetrySample {
+    VehicleState state;
+    uint32_t time_ms;
+};
+
+//Encodes a vehicle state frame into out, returns the frame length
+size_t encodeTelemetryFrame(const TelemetrySample &sample, uint8_t *out);
+
+//Encodes a speeding event frame into out, returns the frame length
+size_t encodeSpeedingFrame(const SpeedingEvent &event, uint8_t *out);
+
+class Telemetry {
+public:
+    Telemetry(PinName tx, PinName rx, int baud, const ThreadConfig &config);
+
+    void start();
+    void publish(const VehicleState &state, uint32_t time_ms);     //Called from the sim, never blocks
+    void publishEvent(const SpeedingEvent &event);                  //Called from the averaging task, never blocks
+
+    uint32_t sent() const { return _sent; }
+    uint32_t dropped() const { return _dropped; }
+    const Thread &thread() const { return _thread; }
+
+private:
+    void run();
+
+    UARTSerial _serial;
+    const ThreadConfig &_config;
+    Thread _thread;
+    SpscRing<TelemetrySample, TELEMETRY_QUEUE_SIZE> _queue;
+    uint32_t _cursor;                   //Read position in the queue, only used by the telemetry thread
+    SpscRing<SpeedingEvent, TELEMETRY_EVENT_QUEUE_SIZE> _events;
+    uint32_t _event_cursor;
+    volatile uint32_t _sent;
+    volatile uint32_t _dropped;
+};
+
+#endif
@@ -0,0 +1,66 @@
+#ifndef THREAD_CONFIG_H
+#define THREAD_CONFIG_H
+
+#include "mbed.h"
+
+#define STACK_FILL_WORD 0xCCCCCCCCu     //RTX stack fill pattern, Thread::max_stack() counts words still holding it as unused
+#define RM_BOUND_PPM 693147             //Liu and Layland utilisation bound for any number of tasks, ln 2 in parts per million
+
+/*
+################################################################################
+Thread configuration
+Name, priority, stack and timing of one thread. Stacks are static buffers supplied by
+the caller, so they are sized per thread and appear in the linker map rather
+than being taken from the heap when the thread starts. Call prepareStack()
+before starting the thread, it fills the stack with the RTX fill pattern so
+Thread::max_stack() reports the high water mark even when the RTX watermark
+option is off.
+Periodic threads also carry their period and an execution time budget, the
+worst case estimate of one step. Tables of them are constexpr so the checks
+below can be used in static_assert, and everything derived from a period
+folds at compile time. Service threads that wait on events have period 0.
+################################################################################
+*/
+struct ThreadConfig {
+    const char *name;
+    osPriority priority;
+    uint32_t stack_size;                //Bytes, a multiple of 8
+    unsigned char *stack;               //8 byte aligned
+    uint32_t period_ms;                 //0 if not periodic
+    uint32_t budget_us;                 //Estimated longest step, compare with TaskStats::exec_max_us
+};
+
+inline void prepareStack(const ThreadConfig &config){
+    uint32_t *words = (uint32_t *)config.stack;
+    for(uint32_t i = 0; i < config.stack_size / sizeof(uint32_t); i++){
+        words[i] = STACK_FILL_WORD;
+    }
+}
+
+//Share of the CPU the budgets use, in parts per million
+template<size_t N>
+constexpr uint32_t utilisationPpm(const ThreadConfig *const (&threads)[N]){
+    uint32_t ppm(0);
+    for(size_t i = 0; i < N; i++){
+        ppm += threads[i]->budget_us * 1000 / threads[i]->period_ms;
+    }
+    return ppm;
+}
+
+//True if every thread has at least the priority of all threads with a longer period
+template<size_t N>
+constexpr bool rateMonotonic(const ThreadConfig *const (&threads)[N]){
+    for(size_t i = 0; i < N; i++){
+        for(size_t j = 0; j < N; j++){
+            if(threads[i]->period_ms < threads[j]->period_ms && threads[i]->priority < threads[j]->priority) return false;
+        }
+    }
+    return true;
+}
+
+//True if the slow thread's period is a whole number of the fast thread's
+constexpr bool harmonic(const ThreadConfig &fast, const ThreadConfig &slow){
+    return fast.period_ms != 0 && slow.period_ms % fast.period_ms == 0;
+}
+
+#endif
@@ -0,0 +1,178 @@
+#include "TripLog.h"
+#include "Crc.h"
+#include <stddef.h>
+
+#define TRIP_MAGIC 0x31505254           //"TRP1"
+#define TRIP_READY_FLAG 0x1             //Thread flag set when a sample is queued
+#define TRIP_FLUSH_FLAG 0x2             //Thread flag set by flush()
+#define TRIP_BATCH 8                    //Samples taken from the queue at a time
+#define TRIP_BLANK_CHUNK 64             //Bytes read at a time when checking for erased flash
+
+static_assert(sizeof(TripBlock) == TRIP_BLOCK_SIZE, "TripBlock must fill exactly one block");
+static_assert(offsetof(TripBlock, records) == TRIP_HEADER_SIZE, "TRIP_HEADER_SIZE does not match TripBlock");
+
+static bool validBlock(const TripBlock &block){
+    return block.magic == TRIP_MAGIC && block.count <= TRIP_RECORDS_PER_BLOCK
+           && block.crc == crc32(&block, offsetof(TripBlock, crc));
+}
+
+TripLog::TripLog(const ThreadConfig &config, InternalFlash &flash)
+    : _config(config), _flash(flash), _stall_handler(NULL), _thread(config.priority, config.stack_size, config.stack, config.name), _cursor(0), _start(0), _slots(0), _slot(0), _ready(false), _speeding(false),
+      _odometer(0), _sequence(0), _speeding_events(0), _dropped(0), _errors(0), _erases(0)
+{
+}
+
+bool TripLog::init(){
+    const uint32_t end = _flash.start() + _flash.size();
+    uint32_t address = end - _flash.sectorSize(end - 1);             //The last sector belongs to the parameters
+    bool ok = _flash.ready() && TRIP_BLOCK_SIZE % _flash.pageSize() == 0;
+    for(int i = 0; ok && i < TRIP_LOG_SECTORS; i++){
+        const uint32_t size = _flash.sectorSize(address - 1);
+        ok = size % TRIP_BLOCK_SIZE == 0;
+        address -= size;
+    }
+#ifdef FLASHIAP_APP_ROM_END_ADDR
+    ok = ok && address >= FLASHIAP_APP_ROM_END_ADDR;                 //Never erase the firmware
+#endif
+    if(ok){
+        _start = address;
+        _slots = (end - _flash.sectorSize(end - 1) - address) / TRIP_BLOCK_SIZE;
+
+        bool found = false;                                         //Newest valid block decides where to continue
+        uint32_t newest = 0;
+        for(uint32_t slot = 0; slot < _slots; slot++){
+            if(!_flash.read(&_block, slotAddress(slot), sizeof(_block)) || !validBlock(_block)) continue;
+            if(!found || (int32_t)(_block.sequence - _sequence) > 0){
+                found = true;
+                newest = slot;
+                _sequence = _block.sequence;
+                _odometer = _block.odometer;
+            }
+        }
+        _slot = found ? (newest + 1) % _slots : 0;
+        _sequence = found ? _sequence + 1 : 0;
+        _ready = true;
+    }
+    beginBlock();
+    return ok;
+}
+
+void TripLog::writeBlock(){
+    if(_block.count == 0) return;
+    _block.sequence = _sequence;
+    _block.crc = crc32(&_block, offsetof(TripBlock, crc));
+
+    bool ok = false;
+    for(uint32_t tries = 0; !ok && tries < _slots; tries++){        //Skip slots left half written by a reset
+        ok = writeSlot();
+        _slot = (_slot + 1) % _slots;
+    }
+    if(ok) _sequence++;
+    else _errors++;
+    beginBlock();
+}
+
+//Programs the block into the current slot, erasing the sector first when the log wraps onto it
+bool TripLog::writeSlot(){
+    const uint32_t address = slotAddress(_slot);
+    if(sectorStart(address)){
+        const uint32_t size = _flash.sectorSize(address);
+        if(!blank(address, size)){
+            if(_stall_handler) _stall_handler(FLASH_ERASE_STALL_MS);
+            _erases++;
+            if(!_flash.erase(address, size)) return false;
+        }
+    }
+    else if(!blank(address, TRIP_BLOCK_SIZE)){
+        return false;
+    }
+    return _flash.program(&_block, address, TRIP_BLOCK_SIZE);
+}
+
+bool TripLog::sectorStart(uint32_t address) const {
+    uint32_t sector = _start;
+    while(sector < address){
+        sector += _flash.sectorSize(sector);
+    }
+    return sector == address;
+}
+
+bool TripLog::blank(uint32_t address, uint32_t size){
+    uint8_t chunk[TRIP_BLANK_CHUNK];
+    const uint8_t erased = _flash.eraseValue();
+    for(uint32_t offset = 0; offset < size; offset += sizeof(chunk)){
+        if(!_flash.read(chunk, address + offset, sizeof(chunk))) return false;
+        for(size_t i = 0; i < sizeof(chunk); i++){
+            if(chunk[i] != erased) return false;
+        }
+    }
+    return true;
+}
+
+void TripLog::start(){
+    if(!_ready) return;
+    prepareStack(_config);
+    _thread.start(callback(this, &TripLog::run));
+}
+
+void TripLog::record(const VehicleState &state, sim_t average, bool speeding, uint32_t time_ms){
+    if(!_ready) return;
+    Entry entry;
+    entry.time_ms = time_ms;
+    entry.odometer = toScaled(state.odometry, 10);
+    const int32_t speed = toScaled(average, 100);
+    entry.speed = speed < 0 ? 0 : speed > 0xFFFF ? 0xFFFF : speed;
+    entry.flags = (state.ignition ? TRIP_RECORD_FLAG_IGNITION : 0) | (state.cruise_mode ? TRIP_RECORD_FLAG_CRUISE : 0)
+                  | (speeding ? TRIP_RECORD_FLAG_SPEEDING : 0);
+    _queue.push(entry);
+    _thread.flags_set(TRIP_READY_FLAG);
+}
+
+void TripLog::flush(){
+    if(_ready) _thread.flags_set(TRIP_FLUSH_FLAG);
+}
+
+void TripLog::beginBlock(){
+    memset(&_block, 0xFF, sizeof(_block));              //Unused records read back as erased flash
+    _block.magic = TRIP_MAGIC;
+    _block.count = 0;
+    _block.speeding_events = 0;
+    _block.speeding_peak = 0;
+}
+
+void TripLog::append(const Entry &entry){
+    TripRecord &record = _block.records[_block.count++];
+    record.time_ms = entry.time_ms;
+    record.speed = entry.speed;
+    record.flags = entry.flags;
+    record.reserved = 0;
+    
+    const bool speeding = entry.flags & TRIP_RECORD_FLAG_SPEEDING;
+    if(speeding && !_speeding){                         //Count each time the speeding indicator comes on
+        _block.speeding_events++;
+        _speeding_events++;
+    }
+    _speeding = speeding;
+    if(speeding && entry.speed > _block.speeding_peak) _block.speeding_peak = entry.speed;
+    _block.odometer = entry.odometer;
+    _odometer = entry.odometer;
+    
+    if(_block.count == TRIP_RECORDS_PER_BLOCK) writeBlock();   //Flash is only written a whole block at a time
+}
+
+void TripLog::run(){
+    Entry entries[TRIP_BATCH];
+    while(true){
+        const uint32_t flags = ThisThread::flags_wait_any(TRIP_READY_FLAG | TRIP_FLUSH_FLAG);
+        while(true){
+            const uint32_t expected = _queue.pushed() - _cursor;
+            const size_t count = _queue.readFrom(_cursor, entries, TRIP_BATCH);
+            if(count == 0) break;
+            if(expected > TRIP_QUEUE_SIZE - 1) _dropped += expected - (TRIP_QUEUE_SIZE - 1);
+            for(size_t i = 0; i < count; i++){
+                append(entries[i]);
+            }
+        }
+        if(flags & TRIP_FLUSH_FLAG) writeBlock();
+    }
+}
@@ -0,0 +1,116 @@
+#ifndef TRIP_LOG_H
+#define TRIP_LOG_H
+
+#include "mbed.h"
+#include "InternalFlash.h"
+#include "SpscRing.h"
+#include "ThreadConfig.h"
+#include "VehicleState.h"
+
+#define TRIP_LOG_SECTORS 2              //Sectors below the parameter sector used for the log, at least 2
+#define TRIP_BLOCK_SIZE 512             //Bytes per flash write, a multiple of the flash page size
+#define TRIP_QUEUE_SIZE 16              //Samples buffered before the logger thread picks them up, power of two
+#define TRIP_RECORD_FLAG_IGNITION 0x01
+#define TRIP_RECORD_FLAG_CRUISE 0x02
+#define TRIP_RECORD_FLAG_SPEEDING 0x04
+
+//One logged sample as stored in flash
+struct TripRecord {
+    uint32_t time_ms;
+    uint16_t speed;                     //Average speed in 0.01 km/h
+    uint8_t flags;
+    uint8_t reserved;
+};
+
+#define TRIP_HEADER_SIZE 20
+#define TRIP_RECORDS_PER_BLOCK ((TRIP_BLOCK_SIZE - TRIP_HEADER_SIZE - 4) / sizeof(TripRecord))
+
+//Block written to flash in one go, padded to exactly TRIP_BLOCK_SIZE
+struct TripBlock {
+    uint32_t magic;
+    uint32_t sequence;                  //Increments with every block, the highest valid one is the newest
+    uint32_t odometer;                  //Odometry in tenths at the last record
+    uint16_t count;                     //Records used, less than a full block after a flush
+    uint16_t speeding_events;           //Speeding events that started in this block
+    uint16_t speeding_peak;             //Highest average speed while speeding in this block, in 0.01 km/h
+    uint16_t reserved;
+    TripRecord records[TRIP_RECORDS_PER_BLOCK];
+    uint32_t crc;                       //CRC-32 of everything above
+};
+
+/*
+################################################################################
+Trip logger
+Samples are queued without locking by the averaging task and collected into a
+RAM block by a low priority thread, which only touches flash once a block is
+full or a flush is requested. Blocks are appended round robin over
+TRIP_LOG_SECTORS sectors, each sector is erased just before the log wraps
+onto it, so all sectors wear at the same rate and the older sector still
+holds the previous part of the trip. Every block carries the odometer, which
+is restored from the newest valid block at start up. A block that was cut
+short by a reset fails its CRC and is skipped.
+Programming a block only takes about a millisecond, but on the LPC1768 a
+sector erase stops the CPU, interrupts included, for up to
+FLASH_ERASE_STALL_MS. That happens once per sector of driving, about every
+13 minutes, and is longer than the deadlines of the control tasks, so every
+task overruns. The stall handler is called just before each erase so the
+Supervisor can tolerate the late periods.
+################################################################################
+*/
+class TripLog {
+public:
+    TripLog(const ThreadConfig &config, InternalFlash &flash);
+
+    bool init();                        //Find the log region and restore the newest block, call before start()
+    void start();
+    void record(const VehicleState &state, sim_t average, bool speeding, uint32_t time_ms);  //Never blocks
+    void flush();                       //Write the partly filled block, e.g. before the ignition goes off
+    void setStallHandler(void (*handler)(uint32_t stall_ms)) { _stall_handler = handler; }  //Called before each sector erase, before start()
+
+    uint32_t odometer() const { return _odometer; }     //Tenths, as restored or last logged
+    uint32_t sequence() const { return _sequence; }     //Blocks written since the log was first used
+    uint32_t speedingEvents() const { return _speeding_events; }
+    uint32_t dropped() const { return _dropped; }
+    uint32_t errors() const { return _errors; }
+    uint32_t erases() const { return _erases; }
+    bool ready() const { return _ready; }
+    const Thread &thread() const { return _thread; }
+
+private:
+    struct Entry {
+        uint32_t time_ms;
+        uint32_t odometer;
+        uint16_t speed;
+        uint8_t flags;
+    };
+
+    void run();
+    void append(const Entry &entry);
+    void writeBlock();
+    void beginBlock();
+    bool writeSlot();
+    uint32_t slotAddress(uint32_t slot) const { return _start + slot * TRIP_BLOCK_SIZE; }
+    bool sectorStart(uint32_t address) const;
+    bool blank(uint32_t address, uint32_t size);
+
+    const ThreadConfig &_config;
+    InternalFlash &_flash;
+    void (*_stall_handler)(uint32_t stall_ms);
+    Thread _thread;
+    SpscRing<Entry, TRIP_QUEUE_SIZE> _queue;
+    uint32_t _cursor;                   //Read position in the queue, only used by the logger thread
+    TripBlock _block;                   //Block being filled, only used by the logger thread after init()
+    uint32_t _start;                    //First byte of the log region
+    uint32_t _slots;                    //Number of blocks the region holds
+    uint32_t _slot;                     //Slot the next block goes to
+    bool _ready;
+    bool _speeding;                     //Speeding flag of the previous record
+    volatile uint32_t _odometer;
+    volatile uint32_t _sequence;
+    volatile uint32_t _speeding_events;
+    volatile uint32_t _dropped;
+    volatile uint32_t _errors;
+    volatile uint32_t _erases;
+};
+
+#endif
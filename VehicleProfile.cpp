@@ -0,0 +1,66 @@
+#include "VehicleProfile.h"
+#include "CarModel.h"
+
+//Definitions for the physics behind the curves, SI units
+#define AIR_DENSITY 1.2                 //kg/m^3
+#define GRAVITY 9.81                    //m/s^2
+#define ROLLING_RAMP_KMH 5.0            //Rolling resistance builds up over the first few km/h so the car comes to rest smoothly
+#define MS_PER_KMH (1 / 3.6)
+
+//Physical description of a car, only used to build the curves
+struct CarPhysics {
+    double mass;                        //kg, including the driver
+    double drag_area;                   //Drag coefficient times frontal area in m^2
+    double rolling;                     //Rolling resistance coefficient
+    double power;                       //Peak engine power at the wheels in W
+    double traction;                    //Most acceleration the tyres can transmit in m/s^2
+    double braking;                     //Deceleration at full brakes in m/s^2
+    double brake_fade;                  //Fraction of braking lost at MAX_SPEED
+};
+
+constexpr CarPhysics hatchback = {1200, 0.65, 0.012, 70000, 3.0, 8.0, 0.15};
+constexpr CarPhysics sports = {1400, 0.60, 0.011, 250000, 9.0, 10.0, 0.05};
+
+//Curves are built from decelerations in m/s^2 at a speed in m/s, returned in km/h per second
+constexpr double dragAt(const CarPhysics &car, double kmh){
+    const double v = kmh * MS_PER_KMH;
+    const double aero = 0.5 * AIR_DENSITY * car.drag_area * v * v / car.mass;
+    const double ramp = kmh < ROLLING_RAMP_KMH ? kmh / ROLLING_RAMP_KMH : 1.0;
+    return (aero + ramp * car.rolling * GRAVITY) * 3.6;
+}
+
+constexpr double engineAt(const CarPhysics &car, double kmh){
+    const double v = kmh * MS_PER_KMH;
+    const double power_limit = v > 0 ? car.power / (car.mass * v) : car.traction;
+    return (power_limit < car.traction ? power_limit : car.traction) * 3.6;     //Torque is limited by grip at low speed, by power above
+}
+
+constexpr double brakeAt(const CarPhysics &car, double kmh){
+    return car.braking * (1 - car.brake_fade * kmh / MAX_SPEED) * 3.6;
+}
+
+constexpr double hatchbackDrag(double kmh) { return dragAt(hatchback, kmh); }
+constexpr double hatchbackEngine(double kmh) { return engineAt(hatchback, kmh); }
+constexpr double hatchbackBrake(double kmh) { return brakeAt(hatchback, kmh); }
+constexpr double sportsDrag(double kmh) { return dragAt(sports, kmh); }
+constexpr double sportsEngine(double kmh) { return engineAt(sports, kmh); }
+constexpr double sportsBrake(double kmh) { return brakeAt(sports, kmh); }
+
+//Tables are evaluated by the compiler and stored in flash
+constexpr SpeedCurve hatchback_drag = makeCurve<CURVE_POINTS>(MIN_SPEED, MAX_SPEED, hatchbackDrag);
+constexpr SpeedCurve hatchback_engine = makeCurve<CURVE_POINTS>(MIN_SPEED, MAX_SPEED, hatchbackEngine);
+constexpr SpeedCurve hatchback_brake = makeCurve<CURVE_POINTS>(MIN_SPEED, MAX_SPEED, hatchbackBrake);
+constexpr SpeedCurve sports_drag = makeCurve<CURVE_POINTS>(MIN_SPEED, MAX_SPEED, sportsDrag);
+constexpr SpeedCurve sports_engine = makeCurve<CURVE_POINTS>(MIN_SPEED, MAX_SPEED, sportsEngine);
+constexpr SpeedCurve sports_brake = makeCurve<CURVE_POINTS>(MIN_SPEED, MAX_SPEED, sportsBrake);
+
+static const VehicleProfile profiles[PROFILE_COUNT] = {
+    {"linear", NULL, NULL, NULL},
+    {"hatchback", &hatchback_drag, &hatchback_engine, &hatchback_brake},
+    {"sports", &sports_drag, &sports_engine, &sports_brake},
+};
+
+const VehicleProfile &vehicleProfile(int id){
+    if(id < 0 || id >= PROFILE_COUNT) id = PROFILE_LINEAR;
+    return profiles[id];
+}
@@ -0,0 +1,42 @@
+#ifndef VEHICLE_PROFILE_H
+#define VEHICLE_PROFILE_H
+
+#include "Curve.h"
+#include <stddef.h>
+
+#define CURVE_POINTS 31                 //Every 10 km/h from 0 to MAX_SPEED
+typedef Curve<CURVE_POINTS> SpeedCurve;
+
+//Vehicle profiles, the index is the "profile" parameter
+enum VehicleProfileId {
+    PROFILE_LINEAR,                     //Original model, drag proportional to speed and full pedals worth PEDAL_RATE
+    PROFILE_HATCHBACK,
+    PROFILE_SPORTS,
+    PROFILE_COUNT
+};
+
+#ifndef VEHICLE_PROFILE
+#define VEHICLE_PROFILE PROFILE_LINEAR  //Profile used until the parameter is changed
+#endif
+
+/*
+################################################################################
+Vehicle profile
+Response curves of a car against speed, all in km/h per second so they add
+up directly to the rate of change of speed. Drag covers aerodynamic drag
+(proportional to speed squared) and rolling resistance, engine is the
+acceleration at full accelerator from the engine torque and power, and brake
+the deceleration at full brakes. The linear profile has no curves and keeps
+the original closed form model, which the fleet model also uses.
+################################################################################
+*/
+struct VehicleProfile {
+    const char *name;
+    const SpeedCurve *drag;             //NULL for the linear model
+    const SpeedCurve *engine;
+    const SpeedCurve *brake;
+};
+
+const VehicleProfile &vehicleProfile(int id);  //Out of range ids give the linear profile
+
+#endif
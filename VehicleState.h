@@ -0,0 +1,56 @@
+#ifndef VEHICLE_STATE_H
+#define VEHICLE_STATE_H
+
+#include "FixedPoint.h"
+#include <stdint.h>
+
+//Numeric type the vehicle model runs in
+#ifndef SIM_FIXED_POINT
+#define SIM_FIXED_POINT 0               //Set to 1 to run the model in Q16.16 fixed point, for targets without an FPU
+#endif
+#if SIM_FIXED_POINT
+typedef Fixed sim_t;                    //Speeds, pedal positions and filter values
+typedef FixedAccumulator odom_t;        //Odometry needs a wider range than Q16.16
+#else
+typedef float sim_t;
+typedef double odom_t;                  //A float total stops growing once increments fall below its resolution
+#endif
+
+//Odometry from a whole number of 1/scale units, the inverse of toScaled()
+inline odom_t odometryFromScaled(int64_t value, int32_t scale){
+#if SIM_FIXED_POINT
+    return FixedAccumulator::fromRaw(value * Fixed::ONE / scale);
+#else
+    return (double)value / scale;
+#endif
+}
+
+/*
+################################################################################
+State of the simulated car, published by the sim task once per step.
+Fields are ordered largest first so the struct packs without padding.
+################################################################################
+*/
+struct VehicleState {
+    odom_t odometry;                    //Distance travelled
+    sim_t speed;                        //Current speed in km/h
+    sim_t accel;                        //Accelerator applied during the last step
+    sim_t brakes;                       //Brakes applied during the last step
+    uint32_t step;                      //Number of sim steps since start
+    bool ignition;
+    bool cruise_mode;                   //Cruise control was driving the pedals
+};
+
+/*
+################################################################################
+Pedal demand from the cruise controller, published by the cruise task.
+Only used by the sim while engaged is set.
+################################################################################
+*/
+struct CruiseCommand {
+    sim_t accel;
+    sim_t brakes;
+    bool engaged;                       //Cruise switch on and ignition on
+};
+
+#endif
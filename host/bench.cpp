@@ -0,0 +1,90 @@
+/*
+################################################################################
+Host benchmark for the vehicle model and cruise controller
+Steps the same CarModel code the firmware runs, with a scripted driver that
+flips the switches every couple of simulated seconds, and reports the cost
+per tick. Build with make in this directory, the float and fixed-point
+variants are separate binaries.
+Usage: bench_float [ticks] [profile]
+################################################################################
+*/
+#include "CarModel.h"
+#include "SpeedFilter.h"
+#include "TaskRates.h"
+#include <chrono>
+#include <stdio.h>
+#include <stdlib.h>
+
+#define DEFAULT_TICKS 10000000
+
+typedef std::chrono::steady_clock bench_clock;
+
+static uint32_t lcg_state(12345);
+
+//Scripted driver, changes the switches every 32 to 95 ticks
+static DriverInputs nextInputs(uint32_t tick){
+    static DriverInputs inputs = DriverInputs();
+    static uint32_t next_change(0);
+    if(tick >= next_change){
+        lcg_state = lcg_state * 1664525u + 1013904223u;
+        inputs.ignition = (lcg_state >> 28) != 0;           //Mostly on
+        inputs.cruise_switch = (lcg_state >> 24) & 1;
+        inputs.accel = (int)((lcg_state >> 22) & 1);
+        inputs.brakes = (int)(((lcg_state >> 20) & 3) == 0); //Brakes less often than accelerator
+        next_change = tick + 32 + ((lcg_state >> 8) & 63);
+    }
+    return inputs;
+}
+
+static double nsPerTick(bench_clock::time_point start, uint32_t ticks){
+    return std::chrono::duration<double, std::nano>(bench_clock::now() - start).count() / ticks;
+}
+
+int main(int argc, char **argv){
+    CruisePid pid(makeCruisePid(CRUISE_PERIOD_MS));
+    ModelParams params = defaultModelParams();
+    const uint32_t ticks = argc > 1 ? strtoul(argv[1], NULL, 10) : DEFAULT_TICKS;
+    if(ticks == 0) return 1;
+    if(argc > 2) params.profile = &vehicleProfile(atoi(argv[2]));
+
+    static DriverInputs script[4096];                       //Pre-generated so input generation is not timed
+    for(uint32_t i = 0; i < 4096; i++) script[i] = nextInputs(i);
+
+    printf("vehicle model benchmark, %s, %s profile, %lu ticks\n", SIM_FIXED_POINT ? "Q16.16 fixed point" : "float",
+           params.profile->name, (unsigned long)ticks);
+
+    VehicleState state = VehicleState();                    //Sim only, with a fixed cruise demand
+    CruiseCommand command = CruiseCommand();
+    bench_clock::time_point start = bench_clock::now();
+    for(uint32_t i = 0; i < ticks; i++){
+        simulateStep(state, params, script[i & 4095], command, SIM_PERIOD_MS * 1000);
+    }
+    const double sim_ns = nsPerTick(start, ticks);
+    const float sim_odometry = toFloat(state.odometry);
+
+    state = VehicleState();                                 //Controller only, against a speed sweep
+    float demand(0);
+    start = bench_clock::now();
+    for(uint32_t i = 0; i < ticks; i++){
+        state.speed = (int)(i & 255);
+        command = cruiseControlStep(pid, params, state, script[i & 4095]);
+        demand += toFloat(command.accel - command.brakes);
+    }
+    const double cruise_ns = nsPerTick(start, ticks);
+
+    state = VehicleState();                                 //Full tick, controller, sim and average filter
+    MovingAverage<sim_t, 3> filter;
+    start = bench_clock::now();
+    for(uint32_t i = 0; i < ticks; i++){
+        command = cruiseControlStep(pid, params, state, script[i & 4095]);
+        simulateStep(state, params, script[i & 4095], command, SIM_PERIOD_MS * 1000);
+        filter.update(state.speed);
+    }
+    const double tick_ns = nsPerTick(start, ticks);
+
+    printf("sim step     %8.2f ns/tick\n", sim_ns);
+    printf("cruise step  %8.2f ns/tick\n", cruise_ns);
+    printf("full tick    %8.2f ns/tick\n", tick_ns);
+    printf("checksum     %.1f %.1f %.1f %.1f\n", sim_odometry, demand, toFloat(state.odometry), toFloat(filter.value()));
+    return 0;
+}
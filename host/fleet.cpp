@@ -0,0 +1,144 @@
+/*
+################################################################################
+Host sweep of cruise controller gains over a fleet of simulated cars
+Every car runs the same scenario, a standing start to the cruise set speed
+and a drop of the set speed half way, each with its own Kp, Ki and Kd from a
+grid around the CRUISE_* defaults. Cars are scored on the integral of the
+absolute speed error plus a penalty for overshoot. Car 0 uses the default
+gains and is checked against the single car CarModel functions.
+Usage: fleet_float [runs]
+################################################################################
+*/
+#include "FleetModel.h"
+#include "TaskRates.h"
+#include <chrono>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#define TIME_STEP_MS 10                 //Common divisor of the two periods
+#define SCENARIO_MS 60000
+#define SECOND_SET_SPEED 60             //Set speed after SCENARIO_MS / 2
+#define OVERSHOOT_WEIGHT 20.0f          //Score per km/h of overshoot
+#define GRID_KP 8
+#define GRID_KI 8
+#define GRID_KD 16
+#define FLEET_SIZE (GRID_KP * GRID_KI * GRID_KD)
+#define DEFAULT_RUNS 4
+
+typedef std::chrono::steady_clock bench_clock;
+
+//Fleet state is large, keep it out of the stack
+static FleetState<FLEET_SIZE> fleet;
+static FleetCommand<FLEET_SIZE> command;
+static FleetCruise<FLEET_SIZE> cruise(CRUISE_PERIOD_MS);
+static float error_total[FLEET_SIZE];   //Integral of |error| in km/h * s
+static float overshoot[FLEET_SIZE];     //Largest speed above the set speed in km/h
+static float gains[FLEET_SIZE][3];
+
+//Kp, Ki and Kd of car i, car 0 gets the defaults
+static void gridGains(size_t car, float *kp, float *ki, float *kd){
+    *kp = CRUISE_KP * (0.25f + 0.25f * (car % GRID_KP));
+    *ki = CRUISE_KI * (0.25f + 0.25f * ((car / GRID_KP) % GRID_KI));
+    *kd = CRUISE_KD * (0.0f + 0.25f * (car / (GRID_KP * GRID_KI)));
+    if(car == 0){
+        *kp = CRUISE_KP;
+        *ki = CRUISE_KI;
+        *kd = CRUISE_KD;
+    }
+}
+
+static ModelParams paramsAt(uint32_t time_ms){
+    ModelParams params = defaultModelParams();
+    if(time_ms >= SCENARIO_MS / 2) params.cruise_speed = SECOND_SET_SPEED;
+    return params;
+}
+
+//One run of the scenario for the whole fleet
+static void runFleet(const DriverInputs &inputs){
+    resetFleet(fleet);
+    cruise.reset();
+    for(size_t i = 0; i < FLEET_SIZE; i++){
+        error_total[i] = 0;
+        overshoot[i] = 0;
+    }
+    for(uint32_t t = 0; t < SCENARIO_MS; t += TIME_STEP_MS){
+        const ModelParams params = paramsAt(t);
+        if(t % CRUISE_PERIOD_MS == 0) cruise.step(params, fleet, inputs, command);
+        if(t % SIM_PERIOD_MS != 0) continue;
+        fleetSimulateStep(fleet, params, inputs, command, SIM_PERIOD_MS * 1000);
+        
+        const float set_speed = toFloat(params.cruise_speed);
+        const bool settling = t < 5000 || (t >= SCENARIO_MS / 2 && t < SCENARIO_MS / 2 + 5000);    //Overshoot is only counted after a set speed change
+        for(size_t i = 0; i < FLEET_SIZE; i++){
+            const float error = set_speed - toFloat(fleet.speed[i]);
+            error_total[i] += fabsf(error) * (SIM_PERIOD_MS / 1000.0f);
+            if(!settling && -error > overshoot[i]) overshoot[i] = -error;
+        }
+    }
+}
+
+//Car 0 again with the single car functions, returns the largest speed difference
+static float checkAgainstCarModel(const DriverInputs &inputs){
+    CruisePid pid(makeCruisePid(CRUISE_PERIOD_MS));
+    VehicleState state = VehicleState();
+    CruiseCommand single = CruiseCommand();
+    FleetState<FLEET_SIZE> &reference = fleet;
+    resetFleet(reference);
+    cruise.reset();
+    float difference(0);
+    for(uint32_t t = 0; t < SCENARIO_MS; t += TIME_STEP_MS){
+        const ModelParams params = paramsAt(t);
+        if(t % CRUISE_PERIOD_MS == 0){
+            single = cruiseControlStep(pid, params, state, inputs);
+            cruise.step(params, reference, inputs, command);
+        }
+        if(t % SIM_PERIOD_MS != 0) continue;
+        simulateStep(state, params, inputs, single, SIM_PERIOD_MS * 1000);
+        fleetSimulateStep(reference, params, inputs, command, SIM_PERIOD_MS * 1000);
+        const float d = fabsf(toFloat(state.speed) - toFloat(reference.speed[0]));
+        if(d > difference) difference = d;
+    }
+    return difference;
+}
+
+int main(int argc, char **argv){
+    const uint32_t runs = argc > 1 ? strtoul(argv[1], NULL, 10) : DEFAULT_RUNS;
+    if(runs == 0) return 1;
+    
+    DriverInputs inputs = DriverInputs();
+    inputs.ignition = true;
+    inputs.cruise_switch = true;
+    
+    for(size_t i = 0; i < FLEET_SIZE; i++){
+        gridGains(i, &gains[i][0], &gains[i][1], &gains[i][2]);
+        cruise.setGains(i, sim_t(gains[i][0]), sim_t(gains[i][1]), sim_t(gains[i][2]));
+    }
+    printf("cruise gain sweep, %s, %d cars, %lu runs of %d s\n", SIM_FIXED_POINT ? "Q16.16 fixed point" : "float",
+           FLEET_SIZE, (unsigned long)runs, SCENARIO_MS / 1000);
+    
+    const bench_clock::time_point start = bench_clock::now();
+    for(uint32_t run = 0; run < runs; run++){
+        runFleet(inputs);
+    }
+    const double seconds = std::chrono::duration<double>(bench_clock::now() - start).count();
+    
+    size_t best = 0;
+    float best_score = 0;
+    for(size_t i = 0; i < FLEET_SIZE; i++){
+        const float score = error_total[i] + OVERSHOOT_WEIGHT * overshoot[i];
+        if(i == 0 || score < best_score){
+            best = i;
+            best_score = score;
+        }
+    }
+    
+    printf("throughput   %8.0f parameter sets/s, %.1f ns per car step\n", FLEET_SIZE * runs / seconds,
+           seconds * 1e9 / ((double)FLEET_SIZE * runs * (SCENARIO_MS / SIM_PERIOD_MS)));
+    printf("default      kp %.3f ki %.3f kd %.4f  error %.1f  overshoot %.2f\n", gains[0][0], gains[0][1], gains[0][2],
+           error_total[0], overshoot[0]);
+    printf("best         kp %.3f ki %.3f kd %.4f  error %.1f  overshoot %.2f\n", gains[best][0], gains[best][1], gains[best][2],
+           error_total[best], overshoot[best]);
+    printf("car model    %.6f km/h largest difference from car 0\n", checkAgainstCarModel(inputs));
+    return 0;
+}
@@ -0,0 +1,151 @@
+/*
+################################################################################
+Host replay of recorded input traces
+Feeds a trace (binary, or the hex printed by the "trace dump" console
+command) through the same input decoding, cruise controller and vehicle
+model as the firmware, with the firmware's task rates on a simulated clock.
+The result only depends on the trace, so two builds can be compared by their
+summary lines. Runs as fast as possible unless --realtime is given, --csv
+prints the state after every sim step.
+Usage: replay_float <trace> [--realtime] [--csv]
+       replay_float --generate <trace> <seconds> [seed]
+################################################################################
+*/
+#include "CarModel.h"
+#include "Switches.h"
+#include "InputTrace.h"
+#include "TaskRates.h"
+#include <chrono>
+#include <thread>
+#include <vector>
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define TIME_STEP_MS 10                 //Common divisor of the periods
+
+static_assert(SIM_PERIOD_MS % TIME_STEP_MS == 0 && CRUISE_PERIOD_MS % TIME_STEP_MS == 0 && INPUT_PERIOD_MS % TIME_STEP_MS == 0,
+              "the replay grid must divide the task periods");
+
+typedef std::chrono::steady_clock replay_clock;
+
+//Reads a binary trace, or a hex dump of one
+static bool loadTrace(const char *path, std::vector<uint8_t> &trace){
+    FILE *file = fopen(path, "rb");
+    if(!file) return false;
+    std::vector<uint8_t> raw;
+    int c;
+    while((c = fgetc(file)) != EOF) raw.push_back(c);
+    fclose(file);
+    
+    if(TraceReader(raw.data(), raw.size()).valid()){
+        trace.swap(raw);
+        return true;
+    }
+    trace.clear();
+    int high = -1;
+    for(size_t i = 0; i < raw.size(); i++){             //Hex digits, anything else is ignored
+        if(!isxdigit(raw[i])) continue;
+        const int digit = isdigit(raw[i]) ? raw[i] - '0' : tolower(raw[i]) - 'a' + 10;
+        if(high < 0){
+            high = digit;
+        }
+        else{
+            trace.push_back(high << 4 | digit);
+            high = -1;
+        }
+    }
+    return TraceReader(trace.data(), trace.size()).valid();
+}
+
+//Writes a trace of a scripted driver for testing, changes the switches every 1.3 to 3.8 s
+static int generate(const char *path, uint32_t seconds, uint32_t seed){
+    std::vector<uint8_t> buffer(16 + seconds * 4);      //Well over one event per second
+    TraceWriter writer(buffer.data(), buffer.size());
+    uint32_t lcg = seed;
+    for(uint32_t t = 0; t < seconds * 1000; ){
+        lcg = lcg * 1664525u + 1013904223u;
+        uint16_t snapshot = 0;
+        if((lcg >> 28) != 0) snapshot |= 1 << ENGINE_SWITCH;         //Mostly on
+        if((lcg >> 24) & 1) snapshot |= 1 << CC_SWITCH;
+        if((lcg >> 22) & 1) snapshot |= 1 << ACCEL_SWITCH;
+        if(((lcg >> 20) & 3) == 0) snapshot |= 1 << BRAKES_SWITCH;   //Brakes less often than accelerator
+        writer.append(t, snapshot);
+        t += (1280 + ((lcg >> 8) & 2047) + INPUT_PERIOD_MS - 1) / INPUT_PERIOD_MS * INPUT_PERIOD_MS;   //On the input task's grid
+    }
+    writer.finish(seconds * 1000);
+    
+    FILE *file = fopen(path, "wb");
+    if(!file || fwrite(writer.data(), 1, writer.size(), file) != writer.size()){
+        fprintf(stderr, "cannot write %s\n", path);
+        return 1;
+    }
+    fclose(file);
+    printf("%s: %lu events, %lu bytes, %lu s\n", path, (unsigned long)writer.events(), (unsigned long)writer.size(),
+           (unsigned long)seconds);
+    return 0;
+}
+
+int main(int argc, char **argv){
+    if(argc >= 4 && strcmp(argv[1], "--generate") == 0){
+        return generate(argv[2], strtoul(argv[3], NULL, 10), argc > 4 ? strtoul(argv[4], NULL, 10) : 12345);
+    }
+    if(argc < 2){
+        fprintf(stderr, "usage: %s <trace> [--realtime] [--csv]\n       %s --generate <trace> <seconds> [seed]\n", argv[0], argv[0]);
+        return 1;
+    }
+    bool realtime(false);
+    bool csv(false);
+    for(int i = 2; i < argc; i++){
+        if(strcmp(argv[i], "--realtime") == 0) realtime = true;
+        else if(strcmp(argv[i], "--csv") == 0) csv = true;
+    }
+    std::vector<uint8_t> trace;
+    if(!loadTrace(argv[1], trace)){
+        fprintf(stderr, "%s is not an input trace\n", argv[1]);
+        return 1;
+    }
+    
+    TracePlayer player(trace.data(), trace.size());
+    CruisePid pid(makeCruisePid(CRUISE_PERIOD_MS));
+    const ModelParams params = defaultModelParams();
+    VehicleState state = VehicleState();
+    CruiseCommand command = CruiseCommand();
+    uint16_t snapshot(0);
+    uint32_t checksum(2166136261u);                     //FNV-1a over the speed in 0.001 km/h after every step
+    uint32_t cruise_steps(0);
+    float top_speed(0);
+    
+    if(csv) printf("time_ms,speed,accel,brakes,odometry,cruise\n");
+    const replay_clock::time_point start = replay_clock::now();
+    for(uint32_t t = 0; t <= player.endMs(); t += TIME_STEP_MS){
+        if(realtime) std::this_thread::sleep_until(start + std::chrono::milliseconds(t));
+        //Same order as the firmware priorities when releases coincide: sim, input, cruise
+        if(t % SIM_PERIOD_MS == 0){
+            simulateStep(state, params, decodeInputs(snapshot), command, SIM_PERIOD_MS * 1000);
+            const int32_t speed = toScaled(state.speed, 1000);
+            for(int i = 0; i < 4; i++){
+                checksum = (checksum ^ ((speed >> (8 * i)) & 0xFF)) * 16777619u;
+            }
+            if(toFloat(state.speed) > top_speed) top_speed = toFloat(state.speed);
+            if(state.cruise_mode) cruise_steps++;
+            if(csv){
+                printf("%lu,%.3f,%.3f,%.3f,%.3f,%d\n", (unsigned long)t, toFloat(state.speed), toFloat(state.accel),
+                       toFloat(state.brakes), toFloat(state.odometry), state.cruise_mode);
+            }
+        }
+        if(t % INPUT_PERIOD_MS == 0) snapshot = player.at(t);
+        if(t % CRUISE_PERIOD_MS == 0) command = cruiseControlStep(pid, params, state, decodeInputs(snapshot));
+    }
+    const double seconds = std::chrono::duration<double>(replay_clock::now() - start).count();
+    
+    if(csv) return 0;
+    printf("replay       %s, %.1f s of driving in %.3f s (%.0fx)\n", SIM_FIXED_POINT ? "Q16.16 fixed point" : "float",
+           player.endMs() / 1000.0, seconds, seconds > 0 ? player.endMs() / 1000.0 / seconds : 0.0);
+    printf("steps        %lu, %lu in cruise\n", (unsigned long)state.step, (unsigned long)cruise_steps);
+    printf("final        speed %.3f km/h, odometry %.1f, top speed %.3f km/h\n", toFloat(state.speed),
+           toFloat(state.odometry), top_speed);
+    printf("checksum     %08lx\n", (unsigned long)checksum);
+    return 0;
+}
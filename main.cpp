@@ -1,210 +1,1130 @@
 #include "MCP23017.h"
 #include "WattBob_TextLCD.h"
+#include "LcdFrameBuffer.h"
+#include "PeriodicTask.h"
+#include "CycleCounter.h"
+#include "FixedFormat.h"
+#include "SpscRing.h"
+#include "SpeedFilter.h"
+#include "Mailbox.h"
+#include "StageLatency.h"
+#include "VehicleState.h"
+#include "CarModel.h"
+#include "Switches.h"
+#include "TaskRates.h"
+#include "InputTrace.h"
+#include "InternalFlash.h"
+#include "ParameterStore.h"
+#include "Console.h"
+#include "Telemetry.h"
+#include "TripLog.h"
+#include "Supervisor.h"
+#include "Pedals.h"
+#include "SpeedingDetector.h"
+#include "StaticObject.h"
+#include "HeapGuard.h"
+#include "HilBench.h"
 #include "mbed.h"
-#include <queue>
-
-//Definitions for switch ports
-#define ENGINE_SWITCH 8                 //Switch 1
-#define ACCEL_SWITCH 9                  //Switch 2
-#define BRAKES_SWITCH 10                //Switch 3
-#define CC_SWITCH 11                    //Switch 4    
-
-//Definitions for simulation variables
-#define MIN_SPEED 0
-#define MAX_SPEED 300
-#define LEGAL_SPEED 142                 //88 mph in km/h , km/h used instead of m/s for more realism for a car's display
-#define CRUISE_SPEED 80                 //50 mph in km/h
-#define CRUISE_BIAS 0.1                 //Bias to improve cruise control's ability to reach cruise speed swiftly
-#define FRICTION 0.001
-#define FRICTION_BIAS 0.8               //Bias required for cruise control to reach cruise speed, generally speaking should be set to CRUISE_SPEED * FRICTION
+
+//Definitions for interrupt driven input capture
+#ifndef INPUT_INTERRUPT
+#define INPUT_INTERRUPT 0               //Set to 1 to read the switches only when the expander signals a change
+#endif
+#define INPUT_INT_PIN p8                //Pin wired to the MCP23017 INTA/INTB outputs
+#define INPUT_FALLBACK_MS 500           //Read the port anyway if no change was signalled for this long
+#define INPUT_CHANGED_FLAG 0x1          //Thread flag set by the interrupt handler
+#define DISPLAY_FRAME_FLAG 0x2          //Thread flag set when the display task posts a frame
+
+//MCP23017 registers used for interrupt-on-change, BANK = 0 so a 16-bit access covers port A then port B
+#define MCP_GPINTEN 0x04                //Interrupt-on-change enable
+#define MCP_INTCON 0x08                 //0 compares against the previous pin value
+#define MCP_IOCON 0x0A
+#define MCP_IOCON_MIRROR 0x40           //INTA and INTB both signal changes on either port
+
+//Definitions for analog pedals
+#ifndef PEDALS_ANALOG
+#define PEDALS_ANALOG 0                 //Set to 1 to read the accelerator and brakes from pots instead of switches 2 and 3
+#endif
+#define ACCEL_PEDAL_PIN p15             //AD0.0
+#define BRAKE_PEDAL_PIN p16             //AD0.1
+
+//Definitions for task periods, the periods themselves are in TaskRates.h
+#define SIM_MAX_STEP_MS (2 * SIM_PERIOD_MS) //Longest time the sim integrates in one go, e.g. after being parked
+
+//Definitions for task budgets, worst case step times in us estimated for the LPC1768 at 96 MHz
+#define SIM_BUDGET_US 1500              //Soft float sub-steps and the telemetry queue
+#define PEDAL_BUDGET_US 200
+#define CRUISE_BUDGET_US 300
+#define AVERAGE_BUDGET_US 300
+#define DISPLAY_BUDGET_US 1000          //Formatting only, the LCD is written by the input task
+#define SUPERVISOR_BUDGET_US 50
+#define PORT_READ_US 500                //One 16-bit read of the expander
+#define LCD_CHAR_US 1000                //Locate and character writes through the expander, per character
+
+//Definitions for the hardware-in-the-loop latency benchmark
+#ifndef HIL_BENCH
+#define HIL_BENCH 0                     //Set to 1 to time switch to LED and frame to LCD latencies with the "hil" command
+#endif
+#define HIL_ENGINE_PIN p21              //Wired to the ignition switch input, switch 1 off
+#define HIL_CRUISE_PIN p22              //Wired to the cruise switch input, switch 4 off
+
+//Definitions for the LCD
+#ifndef LCD_FLUSH_BUDGET
+#define LCD_FLUSH_BUDGET 8              //Characters written per input release, a whole frame takes 4 releases
+#endif
+#define INPUT_BUDGET_US (PORT_READ_US + LCD_FLUSH_BUDGET * LCD_CHAR_US)
+
+//Definitions for the deadline supervisor
+#define SUPERVISOR_CHECK_MS 100         //How often the critical tasks are checked
+#define SUPERVISOR_IDLE_MS 2000         //Check period while the control tasks are parked
+#define WATCHDOG_TIMEOUT_MS 3000        //Reset if a critical task stays late this long, covers an idle check period
+
+//Definitions for thread stack sizes in bytes, check them with the "stacks" console command
+#define SIM_STACK_SIZE 1024
+#define INPUT_STACK_SIZE 1024
+#define CRUISE_STACK_SIZE 1024
+#define AVERAGE_STACK_SIZE 1024
+#define DISPLAY_STACK_SIZE 1024
+#define TELEMETRY_STACK_SIZE 1024
+#define CONSOLE_STACK_SIZE 2048           //Command handlers run on this stack
+#define TRIP_STACK_SIZE 1536              //Flash driver calls run on this stack
+#define SUPERVISOR_STACK_SIZE 768
+#define PEDAL_STACK_SIZE 768
+#define HIL_STACK_SIZE 1024
+
+//Definitions for the serial console
+#define CONSOLE_TX USBTX
+#define CONSOLE_RX USBRX
+#define CONSOLE_BAUD 115200
+
+//Definitions for telemetry
+#ifndef TELEMETRY_ENABLED
+#define TELEMETRY_ENABLED 1             //Stream a binary frame per sim step
+#endif
+#define TELEMETRY_TX p28                //UART2, keeps the USB serial port free for the console
+#define TELEMETRY_RX p27
+#define TELEMETRY_BAUD 115200
+
+//Definitions for input traces
+#ifndef TRACE_BUFFER_SIZE
+#define TRACE_BUFFER_SIZE 2048          //Bytes of RAM for a recorded trace, room for about 500 switch changes
+#endif
+#define TRACE_DUMP_BYTES 32             //Bytes per line of "trace dump"
+
+//Definitions for power management
+#define IDLE_DISPLAY_PERIOD_MS 2000     //Display refresh while parked
+#define IDLE_INPUT_PERIOD_MS 200        //Switch polling while parked, unused with INPUT_INTERRUPT
+#define POWER_CHECK_MS 1000             //How often to check whether the car has stopped
+#define POWER_IGNITION_FLAG 0x1         //Set when the ignition switch changes
+#define STOPPED_SPEED 0.1               //Speed below which the car counts as stopped, drag alone only approaches 0
+
+//Definitions for the average speed filter
+#ifndef AVERAGE_WINDOW_MS
+#define AVERAGE_WINDOW_MS 120           //Time the average speed covers, a whole number of sim periods, e.g. 1000 or 5000
+#endif
+#ifndef AVERAGE_EMA
+#define AVERAGE_EMA 0                   //Set to 1 to use exponential smoothing instead of a moving average
+#endif
+#define SPEED_RING_SIZE 16              //Ring buffer capacity, power of two holding more readings than arrive per AVERAGE_PERIOD_MS
 
 WattBob_TextLCD *lcd;                   //pointer to 2*16 character LCD object
 MCP23017 *par_port;                     //pointer to 16-bit parallel I/O object
+LcdFrameBuffer *display;                //pointer to frame buffer in front of the LCD, only used by the input task
+
+//Storage for the objects above, they talk to the hardware so they are built in main()
+StaticObject<WattBob_TextLCD> lcd_storage;
+StaticObject<MCP23017> par_port_storage;
+StaticObject<LcdFrameBuffer> display_storage;
 
 DigitalOut engine_indicator(LED1);      //output for LED1
 DigitalOut cruising_indicator(LED2);    //output for LED2
 DigitalOut speeding_indicator(LED3);    //output for LED3
 
+//Statically allocated thread stacks
+MBED_ALIGN(8) unsigned char sim_stack[SIM_STACK_SIZE];
+MBED_ALIGN(8) unsigned char input_stack[INPUT_STACK_SIZE];
+MBED_ALIGN(8) unsigned char cruise_stack[CRUISE_STACK_SIZE];
+MBED_ALIGN(8) unsigned char average_stack[AVERAGE_STACK_SIZE];
+MBED_ALIGN(8) unsigned char display_stack[DISPLAY_STACK_SIZE];
+MBED_ALIGN(8) unsigned char telemetry_stack[TELEMETRY_STACK_SIZE];
+MBED_ALIGN(8) unsigned char console_stack[CONSOLE_STACK_SIZE];
+MBED_ALIGN(8) unsigned char trip_stack[TRIP_STACK_SIZE];
+MBED_ALIGN(8) unsigned char supervisor_stack[SUPERVISOR_STACK_SIZE];
+#if PEDALS_ANALOG
+MBED_ALIGN(8) unsigned char pedal_stack[PEDAL_STACK_SIZE];
+#endif
+#if HIL_BENCH
+MBED_ALIGN(8) unsigned char hil_stack[HIL_STACK_SIZE];
+#endif
+
+/*
+################################################################################
+Thread table
+Priorities are rate monotonic, the shorter the period the higher the
+priority. The sim is put above the input task at the same rate because the
+input task also writes the LCD. The pedal sampler is the fastest task, it only
+runs a few ADC conversions per release. The main thread runs the power manager at
+osPriorityNormal and sleeps between checks. The service threads only move
+data that is already queued and run below every periodic task except the
+display. The supervisor sits above them all so it can still see a starved
+task, it only runs for a few microseconds every SUPERVISOR_CHECK_MS.
+The periods here are the only ones the tasks start with, and the checks
+below fail the build if the priorities stop being rate monotonic or the
+budgets no longer fit the Liu and Layland bound.
+################################################################################
+*/
+constexpr ThreadConfig supervisor_thread = {"supervisor", osPriorityRealtime, sizeof(supervisor_stack), supervisor_stack, SUPERVISOR_CHECK_MS, SUPERVISOR_BUDGET_US};
+#if PEDALS_ANALOG
+constexpr ThreadConfig pedal_thread = {"pedals", osPriorityHigh, sizeof(pedal_stack), pedal_stack, PEDAL_PERIOD_MS, PEDAL_BUDGET_US};
+#endif
+constexpr ThreadConfig sim_thread = {"sim", osPriorityAboveNormal3, sizeof(sim_stack), sim_stack, SIM_PERIOD_MS, SIM_BUDGET_US};
+constexpr ThreadConfig input_thread = {"input", osPriorityAboveNormal2, sizeof(input_stack), input_stack, INPUT_PERIOD_MS, INPUT_BUDGET_US};
+constexpr ThreadConfig cruise_thread = {"cruise", osPriorityAboveNormal1, sizeof(cruise_stack), cruise_stack, CRUISE_PERIOD_MS, CRUISE_BUDGET_US};
+constexpr ThreadConfig average_thread = {"average", osPriorityAboveNormal, sizeof(average_stack), average_stack, AVERAGE_PERIOD_MS, AVERAGE_BUDGET_US};
+constexpr ThreadConfig telemetry_thread = {"telemetry", osPriorityBelowNormal1, sizeof(telemetry_stack), telemetry_stack, 0, 0};
+constexpr ThreadConfig display_thread = {"display", osPriorityBelowNormal, sizeof(display_stack), display_stack, DISPLAY_PERIOD_MS, DISPLAY_BUDGET_US};
+constexpr ThreadConfig console_thread = {"console", osPriorityLow, sizeof(console_stack), console_stack, 0, 0};
+constexpr ThreadConfig trip_thread = {"trip", osPriorityLow, sizeof(trip_stack), trip_stack, 0, 0};
+#if HIL_BENCH
+constexpr ThreadConfig hil_thread = {"hil", osPriorityLow, sizeof(hil_stack), hil_stack, 0, 0};
+#endif
+
+//Rate monotonic tasks, the supervisor is deliberately above them
+constexpr const ThreadConfig *periodic_threads[] = {
+#if PEDALS_ANALOG
+    &pedal_thread,
+#endif
+    &sim_thread, &input_thread, &cruise_thread, &average_thread, &display_thread
+};
+
+static_assert(rateMonotonic(periodic_threads), "a task has a lower priority than a task with a longer period");
+static_assert(utilisationPpm(periodic_threads) + supervisor_thread.budget_us * 1000 / supervisor_thread.period_ms <= RM_BOUND_PPM,
+              "task budgets exceed the rate monotonic utilisation bound");
+static_assert(harmonic(sim_thread, average_thread), "the averaging task must see a whole number of sim steps");
+static_assert(harmonic(input_thread, sim_thread), "every sim step must see a new port snapshot");
+#if PEDALS_ANALOG
+static_assert(harmonic(pedal_thread, sim_thread), "every sim step must see the same number of pedal samples");
+#endif
+static_assert(SPEED_RING_SIZE > average_thread.period_ms / sim_thread.period_ms, "speed ring overflows between averaging steps");
+
+//Speed readings averaged, and an exponential smoothing factor comparable to a moving average over them
+constexpr size_t average_window = AVERAGE_WINDOW_MS / sim_thread.period_ms;
+constexpr float average_ema_alpha = 2.0f / (average_window + 1);
+static_assert(average_window >= 1 && AVERAGE_WINDOW_MS % sim_thread.period_ms == 0, "the average must cover a whole number of sim steps");
+static_assert(WATCHDOG_TIMEOUT_MS > SUPERVISOR_LATE_PERIODS * cruise_thread.period_ms + supervisor_thread.period_ms,
+              "watchdog would reset before the supervisor sees a late task");
+static_assert(WATCHDOG_TIMEOUT_MS > SUPERVISOR_IDLE_MS + SUPERVISOR_CHECK_MS, "watchdog would reset while the supervisor is idle");
+
 //Task functions
 void calcAverageSpeed();
 void displayToLCD();
 void cruiseControl();
 void readInputs();
+void servicePort();
 void simulateCar();
+void samplePedals();
+
+//Mailboxes between the pipeline stages, each is posted by a single task and read without locking
+Mailbox<uint16_t> port_inputs;                 //Port snapshot, posted by the input task
+Mailbox<VehicleState> vehicle_state;           //Posted by the sim
+Mailbox<CruiseCommand> cruise_command;         //Posted by the cruise controller
+Mailbox<sim_t> average_speed;                  //Posted by the averaging task
+Mailbox<LcdFrame> display_frame;               //Posted by the display task, written to the LCD by the input task
+#if PEDALS_ANALOG
+Mailbox<PedalReading> pedal_inputs;            //Posted by the pedal task
+#endif
+
+//Age of the messages each stage picks up, listed by the "latency" console command
+StageLatency input_to_cruise("input>cruise");
+StageLatency input_to_sim("input>sim");
+StageLatency cruise_to_sim("cruise>sim");
+StageLatency sim_to_cruise("sim>cruise");
+StageLatency sim_to_filter("sim>filter");
+StageLatency filter_to_display("filter>display");
+StageLatency display_to_lcd("display>lcd");
+#if PEDALS_ANALOG
+StageLatency pedals_to_sim("pedals>sim");
+#endif
+
+//Internal flash shared by the parameters and the trip log, initialised once in main()
+InternalFlash internal_flash;
+
+//Runtime parameters and the console used to change them
+ParameterStore parameters(internal_flash);
+Console console(CONSOLE_TX, CONSOLE_RX, CONSOLE_BAUD, console_thread);
+#if TELEMETRY_ENABLED
+Telemetry telemetry(TELEMETRY_TX, TELEMETRY_RX, TELEMETRY_BAUD, telemetry_thread);
+#endif
+
+//Trip log in flash, fed by the averaging task
+TripLog trip_log(trip_thread, internal_flash);
 
-//Init variables
-bool ignition(0);
-bool cruise_mode(0);
-float accel(0);
-float brakes(0);
-float current_speed(0);
-float average_speed(0);
-float odometry(0);
+//Cruise controller state, only used by the cruise task
+CruisePid cruise_pid(makeCruisePid(cruise_thread.period_ms));
+uint32_t cruise_pid_period_ms(cruise_thread.period_ms);    //Period the PID gains were discretised for
+ModelParams cruise_params;
+uint32_t cruise_params_revision(0);     //Parameter revision cruise_params was built from, 0 before the first
 
-//Queue to store previous speeds
-std::deque<int> avg_speed_queue; 
+//Simulation state, only used by the sim task
+VehicleState sim_state;
+ModelParams sim_params;
+uint32_t sim_params_revision(0);
+uint64_t sim_last_ms(0);                //Time of the previous sim step, 0 before the first
 
-//Init mutexes for sharing resources between threads
-Mutex engineMutex;
-Mutex portMutex;
-Mutex avgSpeedMutex;
+//Input trace, the mode is only changed by the input task when trace_request differs from it
+enum TraceMode { TRACE_IDLE, TRACE_RECORDING, TRACE_REPLAYING };
+uint8_t trace_buffer[TRACE_BUFFER_SIZE];
+TraceWriter trace_writer(trace_buffer, sizeof(trace_buffer));
+TracePlayer trace_player(trace_buffer, 0);
+volatile TraceMode trace_mode(TRACE_IDLE);
+volatile TraceMode trace_request(TRACE_IDLE);   //Written by the console
+uint64_t trace_start_ms(0);
 
-//Init Threads
-Thread thread2Hz;
-Thread thread5Hz;
-Thread threadSim;
-Thread thread20Hz;
-Thread thread25Hz;
+//Display state, display_layout is only used by the display task, display_frame_seen and display_frame_stamp by the input task
+LcdFrameBuffer display_layout;
+uint32_t display_frame_seen(0);
+uint32_t display_frame_stamp(0);                //When the frame being written to the LCD was posted
+
+//Expander traffic, only written by the input task and shown by the "port" console command
+struct PortStats {
+    volatile uint32_t reads;            //16-bit reads of the switches
+    volatile uint32_t characters;       //LCD characters written
+    volatile uint32_t frames;           //Frames completely written to the LCD
+    volatile uint32_t superseded;       //Frames replaced by a newer one before they were completely written
+};
+PortStats port_stats = {0, 0, 0, 0};
+
+//Ring buffer to store previous speeds, written by the sim and drained by the averaging task
+SpscRing<Stamped<sim_t>, SPEED_RING_SIZE> speed_history;
+uint32_t speed_history_cursor(0);
+
+//Filter producing the average speed, updated once per speed reading
+#if AVERAGE_EMA
+ExponentialAverage<sim_t> speed_filter(average_ema_alpha);
+#else
+MovingAverage<sim_t, average_window> speed_filter;
+#endif
+
+//Speeding events from the average speed, only used by the averaging task
+SpeedingDetector speeding_detector;
+
+//Power management state, low_power is only written by the main thread
+EventFlags power_events;
+bool low_power(false);
+
+//Init periodic tasks, each runs on its own thread
+PeriodicTask task2Hz(display_thread, displayToLCD);
+PeriodicTask task5Hz(average_thread, calcAverageSpeed);
+PeriodicTask taskSim(sim_thread, simulateCar);
+PeriodicTask task20Hz(cruise_thread, cruiseControl);
+#if INPUT_INTERRUPT                     //Reads the port when the expander signals a change
+Thread inputThread(input_thread.priority, input_thread.stack_size, input_thread.stack, input_thread.name);
+InterruptIn input_interrupt(INPUT_INT_PIN);
+#else
+PeriodicTask task25Hz(input_thread, servicePort);
+#endif
+#if PEDALS_ANALOG
+PedalChannel accel_pedal(ACCEL_PEDAL_PIN);
+PedalChannel brake_pedal(BRAKE_PEDAL_PIN);
+PeriodicTask taskPedals(pedal_thread, samplePedals);
+#endif
+
+//Watches the control tasks, sheds the slow ones under overload and kicks the watchdog
+Supervisor supervisor(supervisor_thread, WATCHDOG_TIMEOUT_MS, SUPERVISOR_IDLE_MS);
+
+#if HIL_BENCH                           //Drives the switch inputs and times the responses
+#if INPUT_INTERRUPT
+HilBench hil_bench(hil_thread, HIL_ENGINE_PIN, HIL_CRUISE_PIN, NULL, task20Hz);
+#else
+HilBench hil_bench(hil_thread, HIL_ENGINE_PIN, HIL_CRUISE_PIN, &task25Hz, task20Hz);
+#endif
+#endif
+
+/*
+################################################################################
+Input trace record and replay
+While recording, every change of the switches is added to the trace in
+RAM with its time. While replaying, the switch bits of the snapshot come
+from the trace instead of the port, timed from the start of the replay, and
+the switches take over again when the trace ends. Runs in the input task so
+the rest of the pipeline cannot tell a replay from the real switches.
+################################################################################
+*/
+uint16_t traceInputs(uint16_t inputs){
+    const uint64_t now = Kernel::get_ms_count();
+    const TraceMode request = trace_request;
+    if(request != trace_mode){                          //Console asked for a new mode
+        if(trace_mode == TRACE_RECORDING) trace_writer.finish(now - trace_start_ms);
+        if(request == TRACE_RECORDING) trace_writer.reset();
+        if(request == TRACE_REPLAYING) trace_player = TracePlayer(trace_writer.data(), trace_writer.size(), inputs);
+        trace_start_ms = now;
+        trace_mode = request;
+    }
+    
+    const uint32_t elapsed = now - trace_start_ms;
+    if(trace_mode == TRACE_RECORDING && !trace_writer.append(elapsed, inputs & SWITCH_MASK)){  //Port A also reads back the LCD lines
+        trace_mode = trace_request = TRACE_IDLE;        //Buffer full, keep what was recorded
+    }
+    else if(trace_mode == TRACE_REPLAYING){
+        inputs = (inputs & ~SWITCH_MASK) | (trace_player.at(elapsed) & SWITCH_MASK);
+        if(trace_player.finished()) trace_mode = trace_request = TRACE_IDLE;
+    }
+    return inputs;
+}
 
 /*
 ################################################################################
 Function to perform Task 1, 2 and 3
-Reads switch inputs for ignition, accelerator and brakes.
-Disables setting of digital input values if cruise mode is enabled.
-Runs at 25 Hz
+Reads the whole 16-bit port in a single I2C transaction and posts it as a
+snapshot. Ignition, accelerator and brakes are decoded from the snapshot by
+the sim, which decides whether the pedals or the cruise control drive the car.
+Runs at 25 Hz, or on every switch change with INPUT_INTERRUPT
 ################################################################################
 */
 void readInputs(){
+    const uint16_t inputs = traceInputs(par_port->read());  //Read all switches at once, recorded or replaced by a trace
+    port_stats.reads++;
+    
+    const uint16_t previous = port_inputs.read();
+    port_inputs.post(inputs);                           //Post snapshot for the other tasks
+    const bool ignition = SWITCH_ON(inputs, ENGINE_SWITCH);
+    engine_indicator = ignition;                        //Set LED to ignition switch value (on/off)
+#if HIL_BENCH
+    hil_bench.output(HIL_ENGINE_LED, ignition);
+#endif
+    
+    if(SWITCH_ON(inputs ^ previous, ENGINE_SWITCH)){    //Let the power manager know about ignition changes
+        power_events.set(POWER_IGNITION_FLAG);
+    }
+}
+
+/*
+################################################################################
+Writes the newest frame from the display task to the LCD. Only the characters
+that changed are sent, and at most LCD_FLUSH_BUDGET of them per call so the
+blocking I2C transfers for the LCD never hold up the switch reads or the
+cruise task for long. The rest of the frame goes out on the next releases,
+or is replaced by a newer frame if one arrives first.
+################################################################################
+*/
+void writeDisplay(){
+    Stamped<LcdFrame> frame;
+    if(display_frame.receiveNew(display_frame_seen, frame, display_to_lcd)){
+        if(display->pending()) port_stats.superseded++;
+        display->load(frame.value);
+        display_frame_stamp = frame.stamp;
+    }
+    const size_t written = display->flush(LCD_FLUSH_BUDGET);
+    port_stats.characters += written;
+    if(written && !display->pending()){
+        port_stats.frames++;
+#if HIL_BENCH
+        hil_bench.frameShown(display_frame_stamp);
+#endif
+    }
+}
+
+/*
+################################################################################
+Port stage
+The input task is the only task using the I2C port expander, so the switch
+reads and the LCD writes are never interleaved and no task waits on a lock
+for the port. The display task only posts frames here.
+################################################################################
+*/
+void servicePort(){
+    readInputs();
+    writeDisplay();
+}
+
+#if PEDALS_ANALOG
+/*
+################################################################################
+Samples the accelerator and brake pots and posts the filtered positions.
+The conversions and filtering run here instead of in the sim, which only
+picks up the newest reading, so the analog pedals add no ADC time to the
+sim step. Only the switches are recorded in input traces.
+Runs at 100 Hz
+################################################################################
+*/
+void samplePedals(){
+    PedalReading pedals;
+    pedals.accel = accel_pedal.sample();
+    pedals.brakes = brake_pedal.sample();
+    pedal_inputs.post(pedals);
+}
+#endif
+
+#if INPUT_INTERRUPT
+/*
+################################################################################
+Interrupt driven input capture
+The MCP23017 raises INTA/INTB when one of the switch inputs changes. The
+handler only wakes the input thread, the port is read (which also clears the
+interrupt) from thread context as I2C cannot be used from an interrupt. The
+port is also read every INPUT_FALLBACK_MS in case a change was missed, and
+whenever the display task wakes the thread with a new frame, and at the
+polling rate while a frame is still being written.
+################################################################################
+*/
+void onInputChange(){
+    inputThread.flags_set(INPUT_CHANGED_FLAG);
+}
+
+void configureInputInterrupt(){                             //Called before the input thread starts
+    const int iocon = par_port->readRegister(MCP_IOCON) & 0xFF;
+    par_port->writeRegister(MCP_IOCON, (iocon | MCP_IOCON_MIRROR) * 0x0101);   //IOCON is mirrored at both addresses
+    par_port->writeRegister(MCP_INTCON, 0);                 //Interrupt on any change
+    par_port->writeRegister(MCP_GPINTEN, SWITCH_MASK);      //Only the switch inputs
+    par_port->read();                                       //Clear anything already pending
+    
+    input_interrupt.mode(PullUp);                           //INT outputs are active low
+    input_interrupt.fall(onInputChange);
+}
+
+void inputEvents(){
     while(true){
-        portMutex.lock();                                   //Let Mutexes wait  
-        
-        ignition = par_port->read_bit(ENGINE_SWITCH);       //Read ignition switch and set digital input
-        engine_indicator = ignition;                        //Set LED to digital input's value (on/off)
-        
-        if(!cruise_mode){                                   //Only read accel & brake inputs when not in cruise mode
-            accel = par_port->read_bit(ACCEL_SWITCH);       //Read accel switch and set digital input
-            brakes = par_port->read_bit(BRAKES_SWITCH);     //Read brakes switch and set digital input
-        }
-                                                            
-        portMutex.unlock();                                 //Unlock Mutexes
-        ThisThread::sleep_for(40);                          //Sleep thread
+        servicePort();
+        const bool polling = trace_mode == TRACE_REPLAYING || display->pending();   //A replay changes the inputs without interrupts
+        const uint32_t timeout = polling ? input_thread.period_ms : INPUT_FALLBACK_MS;     //A partly written frame is finished at the polling rate
+        ThisThread::flags_wait_any_for(INPUT_CHANGED_FLAG | DISPLAY_FRAME_FLAG, timeout);
     }
 }
+#endif
 
 /*
 ################################################################################
 Function to perform Task 5
-Monitors speed and calculates the average speed over 3 readings.
-If average speed goes above 142 km/h (=88mph) turns on speeding indicator.
+Monitors speed and calculates the average speed over the last AVERAGE_WINDOW_MS.
+Only the readings pushed since the last run are fed to the filter, so the work
+per run does not depend on the window size.
+The average speed is fed to the speeding detector, which turns the speeding
+indicator on once it has stayed above the legal speed parameter (142 km/h =
+88 mph by default) for speeding_hold seconds, and off once it has dropped
+speeding_hyst below it. The LED is only written on these events, which are
+also sent as telemetry frames and counted by the trip log.
 Runs at 5 Hz
 ################################################################################
 */
 void calcAverageSpeed(){
-    while(true){
-        avgSpeedMutex.lock();                               //Let Mutexes wait
-        
-        float sum(0);                                       //Init sum variable
-        for(auto it = avg_speed_queue.begin();it!=avg_speed_queue.end(); ++it){      
-            sum+= *it;                                      //Add average speeds stored in queue to sum
-        }
-        average_speed = sum/avg_speed_queue.size();         //Update average speed
-        speeding_indicator = (average_speed > LEGAL_SPEED); //Turn LED on if average speed is over the allowed speed
-        
-        avgSpeedMutex.unlock();                             //Unlock Mutexes
-        ThisThread::sleep_for(200);                         //Sleep thread
+    Stamped<sim_t> samples[SPEED_RING_SIZE];
+    const size_t count = speed_history.readFrom(speed_history_cursor, samples, SPEED_RING_SIZE);   //Copy new speeds without locking
+    if(count == 0) return;                              //No new speed readings
+    
+    for(size_t i = 0; i < count; i++){      
+        speed_filter.update(samples[i].value);          //Feed each new reading to the filter
+        sim_to_filter.record(samples[i].stamp);
+    }
+    const sim_t average = speed_filter.value();
+    average_speed.post(average);                        //Update average speed
+    
+    const uint32_t now = (uint32_t)Kernel::get_ms_count();
+    SpeedingEvent event;
+    if(speeding_detector.update(average, sim_t(parameters.get(PARAM_LEGAL_SPEED)), sim_t(parameters.get(PARAM_SPEEDING_HYSTERESIS)),
+                                (uint32_t)(parameters.get(PARAM_SPEEDING_HOLD) * 1000), now, event)){
+        speeding_indicator = event.type == SPEEDING_ENTER;  //Edges only
+#if TELEMETRY_ENABLED
+        telemetry.publishEvent(event);
+#endif
     }
+    trip_log.record(vehicle_state.read(), average, speeding_detector.speeding(), now);    //Queued, flash is written by the logger thread
 }
 
 /*
 ################################################################################
 Function to perform Task 6
-Displays odometer value and average speed on LCD display
+Displays odometer value and average speed on LCD display.
+Values are copied from the posted state as fixed-point tenths and formatted
+into a frame without float printf. The frame is posted to the input task,
+which owns the port and writes the characters that changed.
 Runs at 2 Hz
 ################################################################################
 */
 void displayToLCD(){
-    while(true){
-        avgSpeedMutex.lock();                               //Let Mutexes wait                                 
-        portMutex.lock();
-                                                            //Print average speed and odometry to LCD
-        lcd->locate(0,0);                                   
-        lcd->printf("speed: %9.1f", average_speed);
-        lcd->locate(1,0);
-        lcd->printf("odom : %9.1f", odometry);
-                                                            
-        avgSpeedMutex.unlock();                             //Unlock Mutexes
-        portMutex.unlock();
-        
-        ThisThread::sleep_for(500);                         //Sleep thread 
-    }
+    const int32_t speed = toScaled(average_speed.receive(filter_to_display), 10);  //Copy values to display in tenths
+    const int32_t odom = toScaled(vehicle_state.read().odometry, 10);
+                                                        //Format average speed and odometry into the frame
+    display_layout.print(0, 0, "speed: ");
+    display_layout.printFixed(0, 7, 9, speed, 1);
+    display_layout.print(1, 0, "odom : ");
+    display_layout.printFixed(1, 7, 9, odom, 1);
+    
+    display_frame.post(display_layout.frame());         //Hand the frame to the port stage
+#if INPUT_INTERRUPT
+    inputThread.flags_set(DISPLAY_FRAME_FLAG);          //Input thread otherwise sleeps until a switch changes
+#endif
+}
+
+/*
+################################################################################
+Rebuilds a task's copy of the model parameters if the store has changed since
+it was last built, returns true if it did
+################################################################################
+*/
+bool updateModelParams(ModelParams &params, uint32_t &revision){
+    const uint32_t current = parameters.revision();
+    if(current == revision) return false;
+    revision = current;
+    params.cruise_speed = parameters.get(PARAM_CRUISE_SPEED);
+    params.max_speed = parameters.get(PARAM_MAX_SPEED);
+    params.profile = &vehicleProfile((int)(parameters.get(PARAM_VEHICLE_PROFILE) + 0.5f));
+    return true;
 }
 
 /*
 ################################################################################
 Function to perform Task 7
-Reads cruise control switch input, and sets digital inputs for accelerator and 
-brakes to the result of a very simple proportional controller.
-FRICTION_BIAS is used to counter the deceleration due to drag, and CRUISE_BIAS
-is used to ensure the rate at which the cruise control reaches its cruise speed
-is not too slow.
+Decodes cruise control switch from the latest port snapshot, and posts
+accelerator and brakes demands computed by the PID in cruiseControlStep()
+from the latest vehicle state.
 Runs at 20 Hz
 ################################################################################
 */
 void cruiseControl(){
-    while(true){
-        portMutex.lock();                                           //Let Mutexes wait
-        
-        cruise_mode = par_port->read_bit(CC_SWITCH);                //Read cruise control switch and set digital input
-        cruising_indicator = ignition ? cruise_mode : 0;            //Set cruise control indicator LED to digital input value (on/off), but always off if ignition is off
-
-        if(cruise_mode && ignition){                                //In cruise control mode only when ignition is on
-                                                                    //If speed is above cruise speed, set accelarator to 0 and set brakes to proportional value
-            if(current_speed>CRUISE_SPEED + FRICTION_BIAS){         
-                accel = 0;
-                brakes = (current_speed - CRUISE_SPEED)/CRUISE_SPEED + CRUISE_BIAS;
-            }                                                       
-                                                                    //If speed is below cruise speed, set brakes to 0 and set accelerator to proportional value
-            else if(current_speed<CRUISE_SPEED + FRICTION_BIAS){    
-                accel = (CRUISE_SPEED - current_speed)/CRUISE_SPEED + CRUISE_BIAS;
-                brakes = 0;
-            }
-            else{                                                   //If speed is exactly the cruise speed, set both digital inputs to 0
-                accel = 0;
-                brakes = 0;
-            }
-        }
-        
-        portMutex.unlock();                                         //Unlock Mutexes
-        ThisThread::sleep_for(50);                                  //Sleep thread
+    const DriverInputs inputs = decodeInputs(port_inputs.receive(input_to_cruise));    //Decode a copy of the latest port snapshot
+    const VehicleState state = vehicle_state.receive(sim_to_cruise);                   //Take a copy of the latest vehicle state
+    
+    const uint32_t period_ms = task20Hz.period_ms();
+    const bool rate_changed = period_ms != cruise_pid_period_ms;
+    if(rate_changed){                                           //The HIL bench sweeps the rate, rebuild the PID for the new one
+        cruise_pid = makeCruisePid(period_ms);
+        cruise_pid_period_ms = period_ms;
+    }
+    if(updateModelParams(cruise_params, cruise_params_revision) || rate_changed){  //Pick up new set speed and gains
+        cruise_pid.setGains(parameters.get(PARAM_CRUISE_KP), parameters.get(PARAM_CRUISE_KI), parameters.get(PARAM_CRUISE_KD));
     }
+    
+    const CruiseCommand command = cruiseControlStep(cruise_pid, cruise_params, state, inputs);
+    cruising_indicator = command.engaged;                       //Set cruise control indicator LED, always off if ignition is off
+#if HIL_BENCH
+    hil_bench.output(HIL_CRUISE_LED, command.engaged);
+#endif
+    cruise_command.post(command);                               //Post demands for the sim
 }
 
 /*
 ################################################################################
 Function to perform simulation
-Changes current speed depending on digital inputs, and regulates speed between
-to keep speed between minimum and maximum speed defined in definitions above.
-Updates the queue storing previous speed readings with new speed, and updates 
-odometry value.
+Advances the car model by the measured time since the previous step using
+the latest port snapshot and cruise control demand, updates the ring buffer storing previous speed readings with
+the new speed, posts the new vehicle state and queues it for telemetry.
 Runs at 25 Hz
 ################################################################################
 */
 void simulateCar(){
-    while(true){
-        avgSpeedMutex.lock();                                       //Lock Mutexes
-        
-        if(ignition){                           
-            current_speed += (accel-brakes);                        //Update current speed using digital inputs
+    DriverInputs inputs = decodeInputs(port_inputs.receive(input_to_sim));         //Decode a copy of the latest port snapshot
+#if PEDALS_ANALOG
+    applyPedals(inputs, pedal_inputs.receive(pedals_to_sim));                     //Latest filtered positions, no conversions on this thread
+#endif
+    const CruiseCommand command = cruise_command.receive(cruise_to_sim);           //Take a copy of the latest cruise demand
+    
+    const uint64_t now = Kernel::get_ms_count();                //Measure the step instead of assuming SIM_PERIOD_MS
+    uint64_t dt_ms = sim_last_ms ? now - sim_last_ms : sim_thread.period_ms;
+    if(dt_ms > SIM_MAX_STEP_MS) dt_ms = SIM_MAX_STEP_MS;
+    sim_last_ms = now;
+    
+    updateModelParams(sim_params, sim_params_revision);
+    simulateStep(sim_state, sim_params, inputs, command, dt_ms * 1000);
+    speed_history.push(stamped(sim_state.speed));               //Update ring buffer holding previous speeds, oldest is overwritten
+    vehicle_state.post(sim_state);                              //Post consistent snapshot for the other tasks
+#if TELEMETRY_ENABLED
+    telemetry.publish(sim_state, (uint32_t)now);                //Queue a telemetry frame, sent from another thread
+#endif
+}
+
+/*
+################################################################################
+Console commands for the parameter store and cruise control set speed.
+Values are printed with three decimals using the integer formatter.
+################################################################################
+*/
+bool parseValue(const char *text, float *value){
+    int32_t thousandths;
+    if(!parseFixed(text, 3, &thousandths)) return false;
+    *value = thousandths / 1000.0f;
+    return true;
+}
+
+void printParam(Console &out, ParamId id){
+    out.print(ParameterStore::info(id).name);
+    out.print(" = ");
+    out.printFixed(toScaled(parameters.get(id), 1000), 3);
+    out.println();
+}
+
+void paramsCommand(Console &out, int, char **){
+    for(int i = 0; i < PARAM_COUNT; i++) printParam(out, (ParamId)i);
+}
+
+void paramCommand(Console &out, int argc, char **argv){
+    const int id = argc > 1 ? ParameterStore::find(argv[1]) : -1;
+    if(id < 0){
+        out.println("usage: param <name> [value]");
+        return;
+    }
+    float value;
+    if(argc > 2 && !(parseValue(argv[2], &value) && parameters.set((ParamId)id, value))){
+        out.print("value out of range, ");
+    }
+    printParam(out, (ParamId)id);
+}
+
+void saveCommand(Console &out, int, char **){
+    out.println(parameters.save() ? "saved" : "save failed");
+}
+
+void loadCommand(Console &out, int, char **){
+    out.println(parameters.load() ? "loaded" : "no saved parameters");
+}
+
+void defaultsCommand(Console &out, int, char **){
+    parameters.restoreDefaults();
+    out.println("defaults restored");
+}
+
+void cruiseCommand(Console &out, int argc, char **argv){
+    const float set_speed = parameters.get(PARAM_CRUISE_SPEED);
+    const float step = parameters.get(PARAM_CRUISE_STEP);
+    float value;
+    bool ok = true;
+    if(argc > 1){
+        if(strcmp(argv[1], "set") == 0) ok = parameters.set(PARAM_CRUISE_SPEED, toFloat(vehicle_state.read().speed));  //Hold the current speed
+        else if(strcmp(argv[1], "+") == 0) ok = parameters.set(PARAM_CRUISE_SPEED, set_speed + step);
+        else if(strcmp(argv[1], "-") == 0) ok = parameters.set(PARAM_CRUISE_SPEED, set_speed - step);
+        else ok = parseValue(argv[1], &value) && parameters.set(PARAM_CRUISE_SPEED, value);
+    }
+    if(!ok) out.print("value out of range, ");
+    printParam(out, PARAM_CRUISE_SPEED);
+}
+
+void addParameterCommands(){
+    console.add("params", "list all parameters", paramsCommand);
+    console.add("param", "param <name> [value] - show or change a parameter", paramCommand);
+    console.add("save", "save parameters to flash", saveCommand);
+    console.add("load", "load parameters from flash", loadCommand);
+    console.add("defaults", "restore default parameters", defaultsCommand);
+    console.add("cruise", "cruise [set|+|-|<km/h>] - show or change the cruise set speed", cruiseCommand);
+}
+
+/*
+################################################################################
+Console command for the trip log, shows the odometer and log counters or
+writes the partly filled block with "trip flush".
+################################################################################
+*/
+void tripCommand(Console &out, int argc, char **argv){
+    if(argc > 1 && strcmp(argv[1], "flush") == 0) trip_log.flush();
+    if(!trip_log.ready()){
+        out.println("trip log unavailable");
+        return;
+    }
+    out.print("odometer = ");
+    out.printFixed(trip_log.odometer(), 1);
+    out.print(", blocks = ");
+    out.printInt(trip_log.sequence());
+    out.print(", speeding = ");
+    out.printInt(trip_log.speedingEvents());
+    out.print(", dropped = ");
+    out.printInt(trip_log.dropped());
+    out.print(", errors = ");
+    out.printInt(trip_log.errors());
+    out.print(", erases = ");
+    out.printInt(trip_log.erases());
+    out.println();
+}
+
+//Called by the trip logger and the parameter store just before a sector erase stops the CPU
+void flashStall(uint32_t stall_ms){
+    supervisor.expectStall(stall_ms);
+}
+
+void addTripCommands(){
+    console.add("trip", "trip [flush] - show the odometer and trip log", tripCommand);
+}
+
+/*
+################################################################################
+Console command for input traces. "trace record" starts recording the
+switches, "trace stop" ends a recording or replay, "trace play" replays the
+recorded trace in real time and "trace dump" prints it in hex for the host
+replay (see host/replay.cpp). Without an argument it shows the trace state.
+################################################################################
+*/
+void traceDump(Console &out){
+    static const char digits[] = "0123456789abcdef";
+    char line[2 * TRACE_DUMP_BYTES + 1];
+    const uint8_t *data = trace_writer.data();
+    for(size_t offset = 0; offset < trace_writer.size(); offset += TRACE_DUMP_BYTES){
+        size_t length = 0;
+        for(size_t i = offset; i < trace_writer.size() && i < offset + TRACE_DUMP_BYTES; i++){
+            line[length++] = digits[data[i] >> 4];
+            line[length++] = digits[data[i] & 0xF];
+        }
+        line[length] = '\0';
+        out.println(line);
+    }
+}
+
+void traceCommand(Console &out, int argc, char **argv){
+    if(argc > 1){
+        if(strcmp(argv[1], "record") == 0) trace_request = TRACE_RECORDING;
+        else if(strcmp(argv[1], "play") == 0) trace_request = TRACE_REPLAYING;
+        else if(strcmp(argv[1], "stop") == 0) trace_request = TRACE_IDLE;
+        else if(strcmp(argv[1], "dump") == 0 && trace_mode == TRACE_IDLE && trace_request == TRACE_IDLE){
+            traceDump(out);
+            return;
         }
         else{
-            accel = 0;
-            current_speed += accel-0.5*brakes;                      //Accelator disabled if ignition is off, and reduced braking due to lack of assisted breaking
+            out.println("usage: trace [record|stop|play|dump], dump only while idle");
+            return;
         }
-        
-       
-        current_speed -= FRICTION*current_speed;                    //Speed reduction with a very basic implementation of drag
-        
-        if(current_speed<MIN_SPEED) current_speed = MIN_SPEED;      //Keep speed between minimum and maximum values previously defined
-        if(current_speed>MAX_SPEED) current_speed = MAX_SPEED;
-        if(avg_speed_queue.size()>3){                               //Update queue holding previous average speeds, only keep 3 latest average speeds
-            avg_speed_queue.pop_front();
+        ThisThread::sleep_for(2 * INPUT_PERIOD_MS);     //Let the input task pick up the request
+    }
+    static const char *const modes[] = {"idle", "recording", "replaying"};
+    out.print(modes[trace_mode]);
+    out.print(", events = ");
+    out.printInt(trace_writer.events());
+    out.print(", bytes = ");
+    out.printInt(trace_writer.size());
+    out.print(" of ");
+    out.printInt(sizeof(trace_buffer));
+    if(trace_writer.full()) out.print(", full");
+    out.println();
+}
+
+void addTraceCommands(){
+    console.add("trace", "trace [record|stop|play|dump] - record and replay the switches", traceCommand);
+}
+
+/*
+################################################################################
+Console command for the pipeline, lists the age of the messages picked up on
+each edge in microseconds, "latency reset" clears the counters.
+################################################################################
+*/
+void latencyCommand(Console &out, int argc, char **argv){
+    const bool reset = argc > 1 && strcmp(argv[1], "reset") == 0;
+    for(size_t i = 0; i < StageLatency::count(); i++){
+        StageLatency *edge = StageLatency::get(i);
+        const LatencyStats stats = edge->stats();
+        out.print(edge->name());
+        out.print(": messages = ");
+        out.printInt(stats.messages);
+        out.print(", mean = ");
+        out.printInt(stats.meanUs());
+        out.print(" us, max = ");
+        out.printInt(stats.latency_max_us);
+        out.println(" us");
+        if(reset) edge->reset();
+    }
+}
+
+/*
+################################################################################
+Console command for the thread stacks, lists the high water mark of every
+thread started from the thread table.
+################################################################################
+*/
+void printStack(Console &out, const Thread &thread){
+    const uint32_t size = thread.stack_size();
+    const uint32_t used = thread.max_stack();
+    out.print(thread.get_name());
+    out.print(": ");
+    out.printInt(used);
+    out.print(" of ");
+    out.printInt(size);
+    out.print(" bytes, ");
+    out.printInt(size ? used * 100 / size : 0);
+    out.println("%");
+}
+
+void stacksCommand(Console &out, int, char **){
+    for(size_t i = 0; i < PeriodicTask::count(); i++){
+        printStack(out, PeriodicTask::get(i)->thread());
+    }
+#if INPUT_INTERRUPT
+    printStack(out, inputThread);
+#endif
+#if TELEMETRY_ENABLED
+    printStack(out, telemetry.thread());
+#endif
+    printStack(out, console.thread());
+    if(trip_log.ready()) printStack(out, trip_log.thread());
+    printStack(out, supervisor.thread());
+#if HIL_BENCH
+    printStack(out, hil_bench.thread());
+#endif
+}
+
+/*
+################################################################################
+Console command for the supervisor, shows whether the sheddable tasks are
+currently shed and how often the critical tasks have fallen behind.
+################################################################################
+*/
+void supervisorCommand(Console &out, int, char **){
+    out.print("shedding: ");
+    out.print(supervisor.shedding() ? "yes" : "no");
+    out.println(supervisor.idle() ? ", idle" : "");
+    out.print("overloads: ");
+    out.printInt(supervisor.overloads());
+    out.print(", late checks: ");
+    out.printInt(supervisor.lateChecks());
+    out.print(", stalls: ");
+    out.printInt(supervisor.stalls());
+    out.print(", watchdog: ");
+    out.println(supervisor.watchdogRunning() ? "on" : "off");
+    for(size_t i = 0; i < PeriodicTask::count(); i++){
+        const PeriodicTask *task = PeriodicTask::get(i);
+        if(!task->shed()) continue;
+        out.print(task->thread().get_name());
+        out.println(" shed");
+    }
+}
+
+/*
+################################################################################
+Console command for the periodic tasks. Load is the mean step time over the
+period, and like the step times includes time spent preempted by higher
+priority tasks, so it is an upper bound for each task. Compare the max step
+time with the budget from the thread table. "tasks reset" clears the
+statistics.
+################################################################################
+*/
+void tasksCommand(Console &out, int argc, char **argv){
+    const bool reset = argc > 1 && strcmp(argv[1], "reset") == 0;
+    for(size_t i = 0; i < PeriodicTask::count(); i++){
+        PeriodicTask *task = PeriodicTask::get(i);
+        const TaskStats stats = task->stats();
+        out.print(task->name());
+        out.print(": load ");
+        out.printFixed(task->period_ms() ? stats.execMeanUs() / task->period_ms() : 0, 1);   //us per ms is per mille
+        out.print("%, step min ");
+        out.printInt(stats.releases ? stats.exec_min_us : 0);
+        out.print(" mean ");
+        out.printInt(stats.execMeanUs());
+        out.print(" max ");
+        out.printInt(stats.exec_max_us);
+        out.print(" budget ");
+        out.printInt(task->config().budget_us);
+        out.print(" us, ");
+        out.printInt(stats.releases);
+        out.print(" runs, ");
+        out.printInt(stats.overruns);
+        out.print(" overruns, ");
+        out.printInt(stats.skipped);
+        out.println(" shed");
+        if(reset) task->resetStats();
+    }
+}
+
+/*
+################################################################################
+Console command for the expander traffic, "port reset" clears the counters.
+Superseded frames mean the display task posts faster than LCD_FLUSH_BUDGET
+lets the input task write them. The MCP23017 driver does not report I2C
+errors, so only the transfers are counted.
+################################################################################
+*/
+void portCommand(Console &out, int argc, char **argv){
+    out.print("reads: ");
+    out.printInt(port_stats.reads);
+    out.print(", lcd characters: ");
+    out.printInt(port_stats.characters);
+    out.print(", frames: ");
+    out.printInt(port_stats.frames);
+    out.print(", superseded: ");
+    out.printInt(port_stats.superseded);
+    out.println();
+    if(argc > 1 && strcmp(argv[1], "reset") == 0){      //Races with the input task at worst lose a count
+        port_stats.reads = 0;
+        port_stats.characters = 0;
+        port_stats.frames = 0;
+        port_stats.superseded = 0;
+    }
+}
+
+/*
+################################################################################
+Console command for the heap. mbed only keeps the statistics when built with
+MBED_HEAP_STATS_ENABLED=1.
+################################################################################
+*/
+void heapCommand(Console &out, int, char **){
+#if MBED_HEAP_STATS_ENABLED
+    mbed_stats_heap_t heap;
+    mbed_stats_heap_get(&heap);
+    out.print("heap: ");
+    out.printInt(heap.current_size);
+    out.print(" bytes in use, ");
+    out.printInt(heap.max_size);
+    out.print(" max, ");
+    out.printInt(heap.alloc_cnt);
+    out.print(" allocations, ");
+    out.printInt(heap.alloc_fail_cnt);
+    out.println(" failed");
+#else
+    out.println("heap statistics off, build with MBED_HEAP_STATS_ENABLED=1");
+#endif
+}
+
+#if TELEMETRY_ENABLED
+/*
+################################################################################
+Console command for the telemetry link. Dropped frames were overwritten in
+the queue before the telemetry thread got to them, i.e. the UART could not
+keep up with the sim.
+################################################################################
+*/
+void telemetryCommand(Console &out, int, char **){
+    out.print("frames sent: ");
+    out.printInt(telemetry.sent());
+    out.print(", dropped: ");
+    out.printInt(telemetry.dropped());
+    out.println();
+}
+#endif
+
+#if HIL_BENCH
+/*
+################################################################################
+Console command for the hardware-in-the-loop benchmark. "hil run" starts the
+sweeps, which take about a minute, "hil" shows the histograms of the last run.
+Each bin counts the latencies below its upper edge in microseconds, the last
+one everything above the one before it.
+################################################################################
+*/
+void printHistogram(Console &out, int path, const LatencyHistogram &histogram){
+    out.print("  ");
+    out.print(HilBench::pathName(path));
+    out.print(": ");
+    out.printInt(histogram.count);
+    out.print(" edges, ");
+    out.printInt(histogram.lost);
+    out.print(" lost, min ");
+    out.printInt(histogram.count ? histogram.min_us : 0);
+    out.print(" mean ");
+    out.printInt(histogram.meanUs());
+    out.print(" max ");
+    out.printInt(histogram.max_us);
+    out.println(" us");
+    out.print("   ");
+    uint32_t edge = HIL_FIRST_BIN_US;
+    for(int bin = 0; bin < HIL_BINS; bin++, edge <<= 1){
+        if(!histogram.bins[bin]) continue;
+        out.print(" <");
+        if(bin == HIL_BINS - 1) out.print("inf");
+        else out.printInt(edge);
+        out.print(":");
+        out.printInt(histogram.bins[bin]);
+    }
+    out.println();
+}
+
+void hilCommand(Console &out, int argc, char **argv){
+    if(argc > 1 && strcmp(argv[1], "run") == 0){
+        const bool started = hil_bench.run();
+        power_events.set(POWER_IGNITION_FLAG);          //Wakes the power manager to leave low power before the first sweep
+        out.println(started ? "hil: running, switches 1 and 4 must be off" : "hil: already running");
+        return;
+    }
+    if(hil_bench.running()) out.println("hil: running");
+    for(size_t i = 0; i < hil_bench.results(); i++){
+        const HilResult &result = hil_bench.result(i);
+        out.print("input ");
+        out.printInt(result.input_ms);
+        out.print(" ms, cruise ");
+        out.printInt(result.cruise_ms);
+        out.print(" ms, ");
+        out.printInt(result.overruns);
+        out.println(" overruns");
+        for(int path = 0; path < HIL_PATHS; path++){
+            printHistogram(out, path, result.paths[path]);
         }
-        avg_speed_queue.push_back(current_speed);
+    }
+}
+#endif
+
+void addPipelineCommands(){
+    console.add("latency", "latency [reset] - show message latency between tasks", latencyCommand);
+    console.add("stacks", "show stack use of each thread", stacksCommand);
+    console.add("supervisor", "show load shedding and watchdog state", supervisorCommand);
+    console.add("tasks", "tasks [reset] - show load and step times of each task", tasksCommand);
+    console.add("port", "port [reset] - show I2C expander traffic", portCommand);
+    console.add("heap", "show heap use", heapCommand);
+#if TELEMETRY_ENABLED
+    console.add("telemetry", "show frames sent and dropped on the telemetry link", telemetryCommand);
+#endif
+#if HIL_BENCH
+    console.add("hil", "hil [run] - time switch to LED and frame to LCD latencies", hilCommand);
+#endif
+}
 
-        odometry += current_speed * 1.0/25.0;                       //Update odometry, keep in mind this thread runs at 25 Hz
+/*
+################################################################################
+Power management
+Once the ignition is off and the car has stopped, the sim, cruise control and
+averaging tasks are parked, the display refreshes slowly and the switches are
+polled slowly (or only on interrupt with INPUT_INTERRUPT). The threads then
+block for long stretches and the RTOS idle thread puts the CPU into plain
+sleep between wakeups. Deep sleep is not reached: the tick is not tickless
+(MBED_TICKLESS is not configured) and the console and telemetry UARTs keep
+their RX interrupts attached, which holds the deep sleep lock. Turning the
+ignition on resumes everything at full rate.
+Runs in the main thread, woken by ignition changes and every POWER_CHECK_MS.
+################################################################################
+*/
+void enterLowPower(){
+    taskSim.park();
+#if PEDALS_ANALOG
+    taskPedals.park();
+#endif
+    task20Hz.park();
+    task5Hz.park();
+    trip_log.flush();                                   //Keep the odometer in flash while the car is off
+    task2Hz.setPeriod(IDLE_DISPLAY_PERIOD_MS);
+#if !INPUT_INTERRUPT
+    task25Hz.setPeriod(IDLE_INPUT_PERIOD_MS);
+#endif
+    supervisor.setIdle(true);                           //Stop waking every SUPERVISOR_CHECK_MS
+    low_power = true;
+}
+
+void exitLowPower(){
+#if !INPUT_INTERRUPT
+    task25Hz.setPeriod(input_thread.period_ms);
+#endif
+    task2Hz.setPeriod(display_thread.period_ms);
+    task5Hz.resume();
+    task20Hz.resume();
+    taskSim.resume();
+#if PEDALS_ANALOG
+    taskPedals.resume();
+#endif
+    supervisor.setIdle(false);
+    low_power = false;
+}
+
+//The bench flips the ignition itself and needs every task running at full rate
+bool benchRunning(){
+#if HIL_BENCH
+    return hil_bench.running();
+#else
+    return false;
+#endif
+}
+
+void powerManager(){
+    while(true){
+        power_events.wait_any(POWER_IGNITION_FLAG, POWER_CHECK_MS); //Sleeps until ignition changes or the next check
         
-        avgSpeedMutex.unlock();                                     //Unlock Mutexes
-        ThisThread::sleep_for(40);                                  //Sleep thread
+        const bool ignition = SWITCH_ON(port_inputs.read(), ENGINE_SWITCH);
+        if(low_power){
+            if(ignition || benchRunning()) exitLowPower();
+        }
+        else if(!ignition && !benchRunning() && vehicle_state.read().speed < sim_t(STOPPED_SPEED)){    //Only park once the car has stopped
+            enterLowPower();
+        }
     }
 }
 
@@ -214,17 +1134,62 @@ Main function
 ################################################################################
 */
 int main(){
-    par_port = new MCP23017(p9,p10,0x40);
-    lcd = new WattBob_TextLCD(par_port);
+    CycleCounter::init();                                           //Start timestamp source for task statistics
+    internal_flash.init();                                          //Only once, nothing frees it
+    parameters.setStallHandler(flashStall);
+    parameters.load();                                              //Use saved tuning if there is any
+    if(trip_log.init()){                                            //Carry on from the odometer saved in the trip log
+        sim_state.odometry = odometryFromScaled(trip_log.odometer(), 10);
+        vehicle_state.post(sim_state);
+    }
+    par_port = par_port_storage.construct(p9,p10,0x40);            //Built in static storage, nothing uses the heap
+    lcd = lcd_storage.construct(par_port);
+    display = display_storage.construct(lcd);
+    markHeapBaseline();                                             //The LCD is a Stream, its FILE is the only allowed malloc()
     par_port->write_bit(1,BL_BIT);                                  //Turn LCD backlight on
     lcd->cls();                                                     //Clear LCD point to first element
+    display->cleared();                                             //Frame buffer now matches the blank LCD
     lcd->locate(0,0);
-                                                                    //Start threads
-    thread2Hz.start(displayToLCD);
-    thread5Hz.start(calcAverageSpeed);
-    thread20Hz.start(cruiseControl);
-    threadSim.start(simulateCar);
-    thread25Hz.start(readInputs);
-                                                                    //Keep threads running
-    while(1);
+    addParameterCommands();
+    addTripCommands();
+    addTraceCommands();
+    addPipelineCommands();
+    console.start();
+#if TELEMETRY_ENABLED
+    telemetry.start();                                              //Before the sim, its first release already publishes
+#endif
+    trip_log.setStallHandler(flashStall);                           //Sector erases stop every task
+    trip_log.start();                                               //Before the averaging task records into it
+                                                                    //Start periodic tasks
+    task2Hz.start();
+    task5Hz.start();
+    task20Hz.start();
+    taskSim.start();
+#if PEDALS_ANALOG
+    taskPedals.start();                                             //Analog accelerator and brakes
+#endif
+#if INPUT_INTERRUPT
+    configureInputInterrupt();                                      //Read switches on change instead of polling
+    prepareStack(input_thread);
+    inputThread.start(inputEvents);
+#else
+    task25Hz.start();
+#endif
+    supervisor.watch(taskSim);                                      //Control path, a late one stops the watchdog kicks
+    supervisor.watch(task20Hz);
+#if !INPUT_INTERRUPT
+    supervisor.watch(task25Hz);
+#endif
+#if PEDALS_ANALOG
+    supervisor.watch(taskPedals);
+#endif
+    supervisor.shedUnderLoad(task5Hz);                              //Shed first under overload
+    supervisor.shedUnderLoad(task2Hz);
+    supervisor.start();
+#if HIL_BENCH
+    hil_bench.start();                                              //Waits for "hil run"
+#endif
+    checkHeapUnused();                                              //Everything is running, HEAP_FREE builds stop here if anything allocated
+                                                                    //Idle in the power manager instead of spinning, so the MCU can sleep
+    powerManager();
 }